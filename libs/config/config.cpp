@@ -72,4 +72,16 @@ Config::Config(const WriterConfig& writerConfig, const std::unordered_map<std::s
     }
 }
 
+WriterOptions Config::GetWriterOptions() const
+{
+    auto options = m_writerConfig.GetOptions();
+    if (options.maxDeferredPrefixes.has_value() == false)
+    {
+        // Without a meter cache, every meter created gets a prefix of its own, so the limit stays at the default
+        options.maxDeferredPrefixes =
+            m_meterCacheSize > 0 ? m_meterCacheSize : WriterOptions::DefaultMaxDeferredPrefixes;
+    }
+    return options;
+}
+
 }  // namespace spectator
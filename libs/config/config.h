@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
 #include <string>
 #include <unordered_map>
 
@@ -10,6 +12,12 @@ namespace spectator {
 class Config
 {
    public:
+    // Maximum number of meters the Registry keeps in its meter cache
+    static constexpr size_t DefaultMeterCacheSize = 10000;
+
+    // How often the Registry sends the totals of its sharded counters
+    static constexpr std::chrono::milliseconds DefaultPublishInterval{5000};
+
     Config(const WriterConfig& writerConfig, const std::unordered_map<std::string, std::string>& extraTags = {});
 
     ~Config() = default;
@@ -23,11 +31,23 @@ class Config
     const std::string& GetWriterLocation() const noexcept { return m_writerConfig.GetLocation(); }
     const WriterType& GetWriterType() const noexcept { return m_writerConfig.GetType(); }
     const unsigned int GetWriterBufferSize() const noexcept { return m_writerConfig.GetBufferSize(); }
+    // The writer options, with the deferred formatting prefix limit defaulting to the meter cache size
+    WriterOptions GetWriterOptions() const;
+
+    size_t GetMeterCacheSize() const noexcept { return m_meterCacheSize; }
+
+    // A size of 0 disables the Registry meter cache
+    void SetMeterCacheSize(size_t meterCacheSize) noexcept { m_meterCacheSize = meterCacheSize; }
+
+    std::chrono::milliseconds GetPublishInterval() const noexcept { return m_publishInterval; }
 
+    void SetPublishInterval(std::chrono::milliseconds interval) noexcept { m_publishInterval = interval; }
 
    private:
     std::unordered_map<std::string, std::string> m_extraTags;
     WriterConfig m_writerConfig;
+    size_t m_meterCacheSize = DefaultMeterCacheSize;
+    std::chrono::milliseconds m_publishInterval = DefaultPublishInterval;
 };
 
 }  // namespace spectator
\ No newline at end of file
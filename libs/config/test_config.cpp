@@ -217,4 +217,20 @@ TEST_F(ConfigTest, MergingTags)
         EXPECT_EQ(config.GetExtraTags().at("custom"), "value");
         EXPECT_EQ(config.GetExtraTags().at("env"), "test");
     }
-}
\ No newline at end of file
+}
+
+TEST_F(ConfigTest, DeferredPrefixesFollowTheMeterCacheSize)
+{
+    WriterConfig writerConfig(WriterTypes::Memory);
+    Config config(writerConfig);
+    EXPECT_EQ(config.GetWriterOptions().maxDeferredPrefixes, Config::DefaultMeterCacheSize);
+
+    config.SetMeterCacheSize(50000);
+    EXPECT_EQ(config.GetWriterOptions().maxDeferredPrefixes, 50000u);
+
+    config.SetMeterCacheSize(0);
+    EXPECT_EQ(config.GetWriterOptions().maxDeferredPrefixes, WriterOptions::DefaultMaxDeferredPrefixes);
+
+    writerConfig.SetMaxDeferredPrefixes(100);
+    EXPECT_EQ(Config(writerConfig).GetWriterOptions().maxDeferredPrefixes, 100u);
+}
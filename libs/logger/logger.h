@@ -41,51 +41,89 @@ class Logger final : public Singleton<Logger>
     Logger(Logger&&) = delete;
     Logger& operator=(Logger&&) = delete;
 
+    static inline thread_local bool s_muted = false;
+
    public:
+    // Drops what the current thread logs while it is alive. The fork handlers use it, because in the child the
+    // logging thread is gone, and its queue may have been locked when the process forked.
+    class Muted
+    {
+       public:
+        Muted() noexcept { s_muted = true; }
+        ~Muted() { s_muted = false; }
+
+        Muted(const Muted&) = delete;
+        Muted& operator=(const Muted&) = delete;
+    };
+
     static spdlog::logger* GetLogger() { return GetInstance().m_logger.get(); }
 
     static void debug(const std::string& msg)
     {
-        GetLogger()->debug(msg);
+        if (s_muted == false)
+        {
+            GetLogger()->debug(msg);
+        }
     }
 
     static void info(const std::string& msg)
     {
-        GetLogger()->info(msg);
+        if (s_muted == false)
+        {
+            GetLogger()->info(msg);
+        }
     }
 
     static void warn(const std::string& msg)
     {
-        GetLogger()->warn(msg);
+        if (s_muted == false)
+        {
+            GetLogger()->warn(msg);
+        }
     }
 
     static void error(const std::string& msg)
     {
-        GetLogger()->error(msg);
+        if (s_muted == false)
+        {
+            GetLogger()->error(msg);
+        }
     }
 
     template <typename... Args>
     static void debug(fmt::format_string<Args...> fmt, Args&&... args)
     {
-        GetLogger()->debug(fmt, std::forward<Args>(args)...);
+        if (s_muted == false)
+        {
+            GetLogger()->debug(fmt, std::forward<Args>(args)...);
+        }
     }
 
     template <typename... Args>
     static void info(fmt::format_string<Args...> fmt, Args&&... args)
     {
-        GetLogger()->info(fmt, std::forward<Args>(args)...);
+        if (s_muted == false)
+        {
+            GetLogger()->info(fmt, std::forward<Args>(args)...);
+        }
     }
 
     template <typename... Args>
     static void warn(fmt::format_string<Args...> fmt, Args&&... args)
     {
-        GetLogger()->warn(fmt, std::forward<Args>(args)...);
+        if (s_muted == false)
+        {
+            GetLogger()->warn(fmt, std::forward<Args>(args)...);
+        }
     }
 
     template <typename... Args>
     static void error(fmt::format_string<Args...> fmt, Args&&... args)
     {
-        GetLogger()->error(fmt, std::forward<Args>(args)...);
+        if (s_muted == false)
+        {
+            GetLogger()->error(fmt, std::forward<Args>(args)...);
+        }
     }
 };
 
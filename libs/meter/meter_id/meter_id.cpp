@@ -1,64 +1,244 @@
 #include <meter_id.h>
 
 #include <util.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <memory>
 #include <sstream>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace spectator {
 
-// Define the static member
-const std::regex INVALID_CHARS("[^-._A-Za-z0-9~^]");
+// Characters allowed in names and tags: [-._A-Za-z0-9~^]. Everything else, including every byte of a multibyte
+// UTF-8 sequence, is replaced with an underscore.
+static constexpr std::array<bool, 256> VALID_CHARS = []
+{
+    std::array<bool, 256> valid{};
+    for (int c = '0'; c <= '9'; c++) valid[c] = true;
+    for (int c = 'A'; c <= 'Z'; c++) valid[c] = true;
+    for (int c = 'a'; c <= 'z'; c++) valid[c] = true;
+    for (const char c : {'-', '.', '_', '~', '^'}) valid[static_cast<unsigned char>(c)] = true;
+    return valid;
+}();
+
+#if defined(__AVX2__) || defined(__SSE2__)
+// Signed byte comparisons treat bytes >= 0x80 as negative, so they fall outside every range and are invalid. The
+// bounds are passed as int so that the +/- 1 adjustments do not trip narrowing warnings.
+#if defined(__AVX2__)
+using Vector = __m256i;
+static constexpr size_t VECTOR_SIZE = 32;
+static constexpr unsigned int ALL_VALID = 0xFFFFFFFF;
 
-std::unordered_map<std::string, std::string> ValidateTags(const std::unordered_map<std::string, std::string>& tags)
+static inline Vector InRange(Vector v, int lo, int hi)
 {
-    std::unordered_map<std::string, std::string> validTags{};
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(static_cast<char>(lo - 1))),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(hi + 1)), v));
+}
 
-    for (const auto& [key, value] : tags)
+static inline unsigned int ValidMask(const char* p)
+{
+    const auto v = _mm256_loadu_si256(reinterpret_cast<const Vector*>(p));
+    auto valid = _mm256_or_si256(InRange(v, '-', '.'), InRange(v, '0', '9'));
+    valid = _mm256_or_si256(valid, _mm256_or_si256(InRange(v, 'A', 'Z'), InRange(v, '^', '_')));
+    valid = _mm256_or_si256(valid, _mm256_or_si256(InRange(v, 'a', 'z'), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('~'))));
+    return static_cast<unsigned int>(_mm256_movemask_epi8(valid));
+}
+#else
+using Vector = __m128i;
+static constexpr size_t VECTOR_SIZE = 16;
+static constexpr unsigned int ALL_VALID = 0xFFFF;
+
+static inline Vector InRange(Vector v, int lo, int hi)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(static_cast<char>(lo - 1))),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8(static_cast<char>(hi + 1))));
+}
+
+static inline unsigned int ValidMask(const char* p)
+{
+    const auto v = _mm_loadu_si128(reinterpret_cast<const Vector*>(p));
+    auto valid = _mm_or_si128(InRange(v, '-', '.'), InRange(v, '0', '9'));
+    valid = _mm_or_si128(valid, _mm_or_si128(InRange(v, 'A', 'Z'), InRange(v, '^', '_')));
+    valid = _mm_or_si128(valid, _mm_or_si128(InRange(v, 'a', 'z'), _mm_cmpeq_epi8(v, _mm_set1_epi8('~'))));
+    return static_cast<unsigned int>(_mm_movemask_epi8(valid));
+}
+#endif
+#endif
+
+size_t FindInvalidChar(std::string_view s, size_t pos) noexcept
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+    for (; pos + VECTOR_SIZE <= s.size(); pos += VECTOR_SIZE)
     {
-        if (IsEmptyOrWhitespace(key) == false && IsEmptyOrWhitespace(value) == false)
+        if (const auto mask = ValidMask(s.data() + pos); mask != ALL_VALID)
         {
-            validTags[key] = value;
+            return pos + static_cast<size_t>(std::countr_zero(~mask));
         }
     }
-    return validTags;
+#endif
+    for (; pos < s.size(); pos++)
+    {
+        if (VALID_CHARS[static_cast<unsigned char>(s[pos])] == false)
+        {
+            return pos;
+        }
+    }
+    return s.size();
+}
+
+void ReplaceInvalidCharsInPlace(std::string& s) noexcept
+{
+    for (auto pos = FindInvalidChar(s, 0); pos < s.size(); pos = FindInvalidChar(s, pos + 1))
+    {
+        s[pos] = '_';
+    }
 }
 
-std::string ReplaceInvalidChars(const std::string& s) { return std::regex_replace(s, INVALID_CHARS, "_"); }
+std::string ReplaceInvalidChars(const std::string& s)
+{
+    auto result = s;
+    ReplaceInvalidCharsInPlace(result);
+    return result;
+}
 
-std::string ToSpectatorId(const std::string& name, const std::unordered_map<std::string, std::string>& tags)
+void AppendSanitized(std::string& out, std::string_view s)
 {
-    std::ostringstream ss;
-    ss << ReplaceInvalidChars(name);
-    if (!tags.empty())
+    const auto start = out.size();
+    out.append(s);
+    for (auto pos = FindInvalidChar(s, 0); pos < s.size(); pos = FindInvalidChar(s, pos + 1))
+    {
+        out[start + pos] = '_';
+    }
+}
+
+std::vector<MeterId::Tag> ValidateTags(const std::unordered_map<std::string, std::string>& tags)
+{
+    std::vector<MeterId::Tag> validTags;
+    validTags.reserve(tags.size());
+
+    for (const auto& [key, value] : tags)
     {
-        for (const auto& [fst, snd] : tags)
+        if (IsEmptyOrWhitespace(key) == false && IsEmptyOrWhitespace(value) == false)
         {
-            ss << "," << ReplaceInvalidChars(fst) << "=" << ReplaceInvalidChars(snd);
+            validTags.emplace_back(key, value);
         }
     }
-    return ss.str();
+    std::sort(validTags.begin(), validTags.end());
+    return validTags;
+}
+
+std::string ToSpectatorId(std::string_view name, const std::vector<MeterId::Tag>& sortedTags)
+{
+    size_t size = name.size();
+    for (const auto& [key, value] : sortedTags)
+    {
+        size += key.size() + value.size() + 2;
+    }
+
+    std::string id;
+    id.reserve(size);
+    AppendSanitized(id, name);
+    for (const auto& [key, value] : sortedTags)
+    {
+        id.push_back(',');
+        AppendSanitized(id, key);
+        id.push_back('=');
+        AppendSanitized(id, value);
+    }
+    return id;
 }
 
 MeterId::MeterId(const std::string& name, const std::unordered_map<std::string, std::string>& tags)
-    : m_name(name), m_tags(ValidateTags(tags))
+    : MeterId(Sorted{}, name, ValidateTags(tags))
+{
+}
+
+MeterId::MeterId(Sorted, std::string_view name, const std::vector<Tag>& sortedTags) : m_name(name)
+{
+    size_t size = 0;
+    for (const auto& [key, value] : sortedTags)
+    {
+        size += key.size() + value.size();
+    }
+
+    m_data.reserve(size);
+    m_offsets.reserve(2 * sortedTags.size() + 1);
+    for (const auto& [key, value] : sortedTags)
+    {
+        m_offsets.push_back(static_cast<uint32_t>(m_data.size()));
+        m_data.append(key);
+        m_offsets.push_back(static_cast<uint32_t>(m_data.size()));
+        m_data.append(value);
+    }
+    m_offsets.push_back(static_cast<uint32_t>(m_data.size()));
+
+    // The offsets disambiguate where each string ends, so equal fingerprints imply equal data in practice. The tags
+    // are sorted, which makes the result independent of the order they were given in.
+    uint64_t hash = std::hash<std::string>{}(m_name);
+    hash ^= std::hash<std::string>{}(m_data) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    for (const auto offset : m_offsets)
+    {
+        hash ^= offset + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    }
+    m_hash = hash;
+    m_spectatord_id = ToSpectatorId(name, sortedTags);
+}
+
+const std::unordered_map<std::string, std::string>& MeterId::GetTags() const { return m_tagMap.GetOrBuild(*this); }
+
+const MeterId::TagMap::Map& MeterId::TagMap::GetOrBuild(const MeterId& id) const
 {
-    m_spectatord_id = ToSpectatorId(name, tags);
+    if (const auto* map = m_map.load(std::memory_order_acquire))
+    {
+        return *map;
+    }
+
+    auto built = std::make_unique<Map>();
+    built->reserve(id.GetTagCount());
+    for (size_t i = 0; i < id.GetTagCount(); i++)
+    {
+        const auto [key, value] = id.GetTag(i);
+        built->emplace(key, value);
+    }
+
+    // Threads that race to build it keep whichever map was stored first
+    const Map* expected = nullptr;
+    if (m_map.compare_exchange_strong(expected, built.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+    {
+        return *built.release();
+    }
+    return *expected;
 }
 
 MeterId MeterId::WithTag(const std::string& key, const std::string& value) const
 {
-    auto new_tags = m_tags;
-    new_tags[key] = value;
-    return MeterId(m_name, new_tags);
+    return WithTags({{key, value}});
 }
 
 MeterId MeterId::WithTags(const std::unordered_map<std::string, std::string>& additional_tags) const
 {
-    auto new_tags = m_tags;
-    for (const auto& [fst, snd] : additional_tags)
+    // Start from the additional tags, which win on conflict, then add the existing tags they do not override
+    auto new_tags = ValidateTags(additional_tags);
+    const auto additional_count = new_tags.size();
+    for (size_t i = 0; i < GetTagCount(); i++)
     {
-        new_tags[fst] = snd;
+        const auto tag = GetTag(i);
+        const auto end = new_tags.begin() + static_cast<std::ptrdiff_t>(additional_count);
+        if (std::binary_search(new_tags.begin(), end, tag,
+                               [](const Tag& a, const Tag& b) { return a.first < b.first; }) == false)
+        {
+            new_tags.push_back(tag);
+        }
     }
-    return MeterId(m_name, new_tags);
+    std::sort(new_tags.begin(), new_tags.end());
+    return MeterId(Sorted{}, GetName(), new_tags);
 }
 
 MeterId MeterId::WithStat(const std::string& stat) const
@@ -66,44 +246,21 @@ MeterId MeterId::WithStat(const std::string& stat) const
     return WithTag("statistic", stat);
 }
 
-bool MeterId::operator==(const MeterId& other) const { return m_name == other.m_name && m_tags == other.m_tags; }
-
 std::string MeterId::to_string() const
 {
     std::ostringstream ss;
-    ss << "MeterId(name=" << m_name << ", tags={";
-    bool first = true;
-    for (const auto& [fst, snd] : m_tags)
+    ss << "MeterId(name=" << GetName() << ", tags={";
+    for (size_t i = 0; i < GetTagCount(); i++)
     {
-        if (!first)
+        const auto [key, value] = GetTag(i);
+        if (i > 0)
         {
             ss << ", ";
         }
-        ss << "'" << fst << "': '" << snd << "'";
-        first = false;
+        ss << "'" << key << "': '" << value << "'";
     }
     ss << "})";
     return ss.str();
 }
 
 }  // namespace spectator
-
-// Implementation of the hash function for MeterId
-size_t std::hash<spectator::MeterId>::operator()(const spectator::MeterId& id) const
-{
-    // Hash the name first
-    const size_t name_hash = std::hash<std::string>{}(id.GetName());
-
-    // Hash the tags
-    size_t tags_hash = 0;
-    for (const auto& [fst, snd] : id.GetTags())
-    {
-        // Combine key and value hashes
-        const size_t pair_hash = std::hash<std::string>{}(fst) ^ std::hash<std::string>{}(snd) << 1;
-        // Combine with the accumulated tags hash
-        tags_hash ^= pair_hash + 0x9e3779b9 + (tags_hash << 6) + (tags_hash >> 2);
-    }
-
-    // Combine name hash and tags hash
-    return name_hash ^ tags_hash << 1;
-}
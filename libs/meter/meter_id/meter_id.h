@@ -1,21 +1,58 @@
 #pragma once
 
-#include <string>
-#include <map>
-#include <regex>
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/container/small_vector.hpp>
 
 namespace spectator {
 
+// Returns the position of the first character at or after pos that is not allowed in a spectatord id, or s.size()
+size_t FindInvalidChar(std::string_view s, size_t pos = 0) noexcept;
+
+// Replaces every character outside [-._A-Za-z0-9~^] with '_'. Clean input is scanned but never written.
+void ReplaceInvalidCharsInPlace(std::string& s) noexcept;
+
+// Returns a copy of s with every character outside [-._A-Za-z0-9~^] replaced by '_'
+std::string ReplaceInvalidChars(const std::string& s);
+
+// Appends s to out with every character outside [-._A-Za-z0-9~^] replaced by '_'
+void AppendSanitized(std::string& out, std::string_view s);
+
 class MeterId
 {
    public:
+    using Tag = std::pair<std::string_view, std::string_view>;
+
     MeterId(const std::string& name, const std::unordered_map<std::string, std::string>& tags = {});
 
-    const std::string& GetName() const noexcept { return m_name; };
+    const std::string& GetName() const noexcept { return m_name; }
     const std::string& GetSpectatordId() const noexcept { return m_spectatord_id; }
-    const std::unordered_map<std::string, std::string>& GetTags() const noexcept { return m_tags; };
+
+    // The map is built on the first call and kept until the id is destroyed or assigned to; prefer GetTagCount and
+    // GetTag, which do not allocate
+    const std::unordered_map<std::string, std::string>& GetTags() const;
+
+    size_t GetTagCount() const noexcept { return m_offsets.size() / 2; }
+
+    // Tags are stored sorted by key, so GetTag(0) has the smallest key
+    Tag GetTag(size_t index) const noexcept
+    {
+        const std::string_view data(m_data);
+        const auto keyStart = m_offsets[2 * index];
+        const auto valueStart = m_offsets[2 * index + 1];
+        return {data.substr(keyStart, valueStart - keyStart),
+                data.substr(valueStart, m_offsets[2 * index + 2] - valueStart)};
+    }
+
+    // 64-bit fingerprint of the name and tags, computed once at construction
+    uint64_t GetHash() const noexcept { return m_hash; }
 
     MeterId WithTag(const std::string& key, const std::string& value) const;
 
@@ -23,14 +60,55 @@ class MeterId
 
     MeterId WithStat(const std::string& stat) const;
 
-    bool operator==(const MeterId& other) const;
+    bool operator==(const MeterId& other) const noexcept
+    {
+        return m_hash == other.m_hash && m_offsets == other.m_offsets && m_name == other.m_name &&
+               m_data == other.m_data;
+    }
 
     std::string to_string() const;
 
    private:
+    struct Sorted
+    {
+    };
+
+    // Owns the map GetTags returns. Copies start without one and build their own when asked.
+    class TagMap
+    {
+       public:
+        using Map = std::unordered_map<std::string, std::string>;
+
+        TagMap() = default;
+        TagMap(const TagMap&) noexcept {}
+        TagMap& operator=(const TagMap& other) noexcept
+        {
+            if (this != &other)
+            {
+                delete m_map.exchange(nullptr, std::memory_order_acq_rel);
+            }
+            return *this;
+        }
+        ~TagMap() { delete m_map.load(std::memory_order_acquire); }
+
+        const Map& GetOrBuild(const MeterId& id) const;
+
+       private:
+        mutable std::atomic<const Map*> m_map{nullptr};
+    };
+
+    // Builds the id from tags that are already validated and sorted by key
+    MeterId(Sorted, std::string_view name, const std::vector<Tag>& sortedTags);
+
     std::string m_name;
-    std::unordered_map<std::string, std::string> m_tags;
+    // The key and value of every tag, sorted by key, without separators
+    std::string m_data;
+    // Offsets in m_data where each key and value starts, followed by the total size. Ids with up to three tags keep
+    // their offsets inline.
+    boost::container::small_vector<uint32_t, 7> m_offsets;
     std::string m_spectatord_id;
+    uint64_t m_hash = 0;
+    TagMap m_tagMap;
 };
 
 }  // namespace spectator
@@ -38,5 +116,5 @@ class MeterId
 template <>
 struct std::hash<spectator::MeterId>
 {
-    size_t operator()(const spectator::MeterId& id) const;
+    size_t operator()(const spectator::MeterId& id) const noexcept { return id.GetHash(); }
 };
@@ -2,6 +2,8 @@
 
 #include <gtest/gtest.h>
 
+#include <regex>
+
 using namespace spectator;
 
 TEST(MeterIdTest, EqualsSameName)
@@ -77,6 +79,21 @@ TEST(MeterIdTest, Tags)
     EXPECT_EQ(expected, id1.GetTags());
 }
 
+TEST(MeterIdTest, TagsAreBuiltOnce)
+{
+    const MeterId id1("foo", {{"a", "1"}, {"b", "2"}});
+    const auto& tags = id1.GetTags();
+    EXPECT_EQ(&tags, &id1.GetTags());
+
+    // Copies have their own map, and assigning replaces it
+    MeterId id2 = id1;
+    EXPECT_NE(&tags, &id2.GetTags());
+    EXPECT_EQ(tags, id2.GetTags());
+    id2 = MeterId("bar");
+    EXPECT_TRUE(id2.GetTags().empty());
+    EXPECT_EQ("bar", id2.GetName());
+}
+
 TEST(MeterIdTest, TagsDefensiveCopy)
 {
     MeterId id1("foo", {{"a", "1"}});
@@ -108,4 +125,100 @@ TEST(MeterIdTest, WithTagsReturnsNewObject)
     EXPECT_EQ(empty, id1.GetTags());
     std::unordered_map<std::string, std::string> expected = {{"a", "1"}, {"b", "2"}};
     EXPECT_EQ(expected, id2.GetTags());
-}
\ No newline at end of file
+}
+
+TEST(MeterIdTest, ReplaceInvalidCharsMatchesRegex)
+{
+    const std::regex invalidChars("[^-._A-Za-z0-9~^]");
+
+    // Every byte value, both on its own and at each offset of strings long enough to take the vectorized path
+    for (int c = 0; c < 256; c++)
+    {
+        for (size_t len : {1, 15, 16, 17, 31, 32, 33, 70})
+        {
+            for (size_t pos = 0; pos < len; pos += 7)
+            {
+                std::string s(len, 'a');
+                s[pos] = static_cast<char>(c);
+                const auto expected = std::regex_replace(s, invalidChars, "_");
+
+                auto actual = s;
+                ReplaceInvalidCharsInPlace(actual);
+                EXPECT_EQ(expected, actual) << "byte " << c << " at " << pos << " of " << len;
+                EXPECT_EQ(expected, ReplaceInvalidChars(s));
+
+                std::string appended = "prefix";
+                AppendSanitized(appended, s);
+                EXPECT_EQ("prefix" + expected, appended);
+            }
+        }
+    }
+}
+
+TEST(MeterIdTest, ReplaceInvalidCharsMultibyte)
+{
+    std::string s = "caf\xC3\xA9-latte.size~^_1 with spaces and a long tail to cross vector widths";
+    ReplaceInvalidCharsInPlace(s);
+    EXPECT_EQ("caf__-latte.size~^_1_with_spaces_and_a_long_tail_to_cross_vector_widths", s);
+}
+
+TEST(MeterIdTest, FindInvalidChar)
+{
+    const std::string clean(100, 'x');
+    EXPECT_EQ(clean.size(), FindInvalidChar(clean));
+    EXPECT_EQ(0, FindInvalidChar(""));
+
+    auto dirty = clean;
+    dirty[40] = ' ';
+    dirty[90] = ':';
+    EXPECT_EQ(40, FindInvalidChar(dirty));
+    EXPECT_EQ(90, FindInvalidChar(dirty, 41));
+    EXPECT_EQ(dirty.size(), FindInvalidChar(dirty, 91));
+}
+
+TEST(MeterIdTest, SpectatordIdIsSorted)
+{
+    const MeterId id1("foo", {{"c", "3"}, {"a", "1"}, {"b", "2"}, {"d", "4"}, {"e", "5"}});
+    const MeterId id2("foo", {{"e", "5"}, {"d", "4"}, {"b", "2"}, {"a", "1"}, {"c", "3"}});
+    EXPECT_EQ("foo,a=1,b=2,c=3,d=4,e=5", id1.GetSpectatordId());
+    EXPECT_EQ(id1.GetSpectatordId(), id2.GetSpectatordId());
+    EXPECT_EQ(id1.GetHash(), id2.GetHash());
+}
+
+TEST(MeterIdTest, InvalidTagsAreDropped)
+{
+    const MeterId id("foo", {{"a", "1"}, {"b", " "}, {"", "2"}});
+    EXPECT_EQ("foo,a=1", id.GetSpectatordId());
+    EXPECT_EQ(1, id.GetTagCount());
+    EXPECT_EQ(MeterId("foo", {{"a", "1"}}), id);
+}
+
+TEST(MeterIdTest, GetTag)
+{
+    const MeterId id("foo", {{"b", "2"}, {"a", "1"}});
+    ASSERT_EQ(2, id.GetTagCount());
+    EXPECT_EQ("a", id.GetTag(0).first);
+    EXPECT_EQ("1", id.GetTag(0).second);
+    EXPECT_EQ("b", id.GetTag(1).first);
+    EXPECT_EQ("2", id.GetTag(1).second);
+}
+
+TEST(MeterIdTest, NotEqualWhenBoundariesDiffer)
+{
+    // The concatenated strings are identical, only the split between name, keys and values differs
+    const MeterId id1("ab", {{"c", "d"}});
+    const MeterId id2("a", {{"bc", "d"}});
+    const MeterId id3("ab", {{"cd", "e"}});
+    const MeterId id4("ab", {{"c", "de"}});
+    EXPECT_NE(id1, id2);
+    EXPECT_NE(id3, id4);
+    EXPECT_NE(std::hash<MeterId>{}(id1), std::hash<MeterId>{}(id2));
+}
+
+TEST(MeterIdTest, WithTagsOverridesExisting)
+{
+    const MeterId id1("foo", {{"a", "1"}, {"b", "2"}});
+    const MeterId id2 = id1.WithTags({{"b", "3"}, {"c", "4"}});
+    EXPECT_EQ(MeterId("foo", {{"a", "1"}, {"b", "3"}, {"c", "4"}}), id2);
+    EXPECT_EQ("foo,a=1,b=3,c=4", id2.GetSpectatordId());
+}
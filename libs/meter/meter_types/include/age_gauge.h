@@ -5,6 +5,7 @@
 #include <writer.h>
 
 #include <string>
+#include <utility>
 
 namespace spectator {
 
@@ -17,15 +18,19 @@ class AgeGauge final : public Meter
 
     void Now() const
     {
-        auto line = this->ConstructLine(0);
-        Writer::GetInstance().Write(line);
+        this->Send(0);
     }
 
     void Set(const double& seconds) const
     {
-        auto line = this->ConstructLine(seconds);
-        Writer::GetInstance().Write(line);
+        this->Send(seconds);
     }
+
+   private:
+    friend class Registry;
+
+    // Used by the Registry to hand out meters that share cached state
+    explicit AgeGauge(MeterStatePtr state) : Meter(std::move(state)) {}
 };
 
 }  // namespace spectator
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace spectator {
+
+// Opt-in for gauges and monotonic counters that are set from polling loops, often to the value they already have
+struct ChangeSuppression
+{
+    // Well within the 15 minutes after which spectatord expires a meter it has not heard from
+    static constexpr std::chrono::milliseconds DefaultKeepalive{60000};
+
+    // Values that differ from the last one sent by at most this much are not sent
+    double epsilon = 0;
+
+    // The value is sent anyway once this long has passed since it was last sent, so that the meter does not expire
+    std::chrono::milliseconds keepalive = DefaultKeepalive;
+};
+
+/**
+ * ChangeFilter - Decides whether a value is worth sending, given the last value that was sent
+ *
+ * The last value and when it was sent are kept in two relaxed atomics. Threads setting the same meter at the same
+ * time may both send, which is harmless, as spectatord keeps the last value either way.
+ */
+class ChangeFilter
+{
+   public:
+    explicit ChangeFilter(const ChangeSuppression& suppression)
+        : m_epsilon(suppression.epsilon),
+          m_keepalive(std::chrono::duration_cast<Clock::duration>(suppression.keepalive))
+    {
+    }
+
+    ChangeFilter(const ChangeFilter&) = delete;
+    ChangeFilter& operator=(const ChangeFilter&) = delete;
+
+    // Returns whether the value should be sent, and if so, remembers it as the last value sent
+    bool ShouldSend(double value) noexcept
+    {
+        const Clock::rep now = Clock::now().time_since_epoch().count();
+        const Clock::rep sentAt = m_sentAt.load(std::memory_order_relaxed);
+        // NaN never compares as unchanged
+        if (sentAt != NEVER && Clock::duration(now - sentAt) < m_keepalive &&
+            std::fabs(value - std::bit_cast<double>(m_lastValue.load(std::memory_order_relaxed))) <= m_epsilon)
+        {
+            return false;
+        }
+
+        m_lastValue.store(std::bit_cast<uint64_t>(value), std::memory_order_relaxed);
+        m_sentAt.store(now, std::memory_order_relaxed);
+        return true;
+    }
+
+   private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr Clock::rep NEVER = std::numeric_limits<Clock::rep>::min();
+
+    const double m_epsilon;
+    const Clock::duration m_keepalive;
+    std::atomic<uint64_t> m_lastValue{0};
+    std::atomic<Clock::rep> m_sentAt{NEVER};  // Ticks of Clock since its epoch
+};
+
+}  // namespace spectator
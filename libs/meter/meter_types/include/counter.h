@@ -5,6 +5,7 @@
 #include <writer.h>
 
 #include <string>
+#include <utility>
 
 namespace spectator {
 
@@ -17,12 +18,21 @@ class Counter final : public Meter
 
     void Increment(const double& delta = 1) const
     {
-        if (delta > 0)
+        if (delta == 1 && m_state->GetWriter().DefersFormatting() == false)
         {
-            auto line = this->ConstructLine(delta);
-            Writer::GetInstance().Write(line);
+            m_state->GetWriter().Write(m_state->GetIncrementLine());
+        }
+        else if (delta > 0)
+        {
+            this->Send(delta);
         }
     }
+
+   private:
+    friend class Registry;
+
+    // Used by the Registry to hand out meters that share cached state
+    explicit Counter(MeterStatePtr state) : Meter(std::move(state)) {}
 };
 
 }  // namespace spectator
@@ -5,6 +5,7 @@
 #include <writer.h>
 
 #include <string>
+#include <utility>
 
 namespace spectator {
 
@@ -19,10 +20,15 @@ class DistributionSummary final : public Meter
     {
         if (amount >= 0)
         {
-            auto line = this->ConstructLine(amount);
-            Writer::GetInstance().Write(line);
+            this->Send(amount);
         }
     }
+
+   private:
+    friend class Registry;
+
+    // Used by the Registry to hand out meters that share cached state
+    explicit DistributionSummary(MeterStatePtr state) : Meter(std::move(state)) {}
 };
 
 }  // namespace spectator
\ No newline at end of file
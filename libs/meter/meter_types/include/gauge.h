@@ -4,7 +4,10 @@
 #include <meter_id.h>
 #include <writer.h>
 
+#include <algorithm>
+#include <chrono>
 #include <string>
+#include <utility>
 #include <optional>
 
 namespace spectator {
@@ -15,17 +18,49 @@ class Gauge final : public Meter
 {
    public:
     explicit Gauge(const MeterId& meter_id, const std::optional<int>& ttl_seconds = std::nullopt)
-        : Meter(meter_id, ttl_seconds.has_value()
-                              ? GAUGE_TYPE_SYMBOL + std::string(",") + std::to_string(ttl_seconds.value())
-                              : GAUGE_TYPE_SYMBOL)
+        : Meter(meter_id, TypeSymbol(ttl_seconds))
     {
     }
 
+    // Set only sends values that differ from the last one sent by more than the epsilon, or once the keepalive
+    // has passed
+    Gauge(const MeterId& meter_id, const std::optional<int>& ttl_seconds, const ChangeSuppression& suppression)
+        : Meter(meter_id, TypeSymbol(ttl_seconds), WithinTtl(suppression, ttl_seconds))
+    {
+    }
+
+    // The type symbol carries the TTL, e.g. "g,120"
+    static std::string TypeSymbol(const std::optional<int>& ttl_seconds)
+    {
+        return ttl_seconds.has_value() ? GAUGE_TYPE_SYMBOL + std::string(",") + std::to_string(ttl_seconds.value())
+                                       : GAUGE_TYPE_SYMBOL;
+    }
+
+    // The keepalive is shortened to half the TTL, so that the gauge is sent again before it would expire. The TTL is
+    // converted in 64 bits, since a TTL of more than about 24 days overflows an int of milliseconds.
+    static ChangeSuppression WithinTtl(ChangeSuppression suppression, const std::optional<int>& ttl_seconds)
+    {
+        if (ttl_seconds.has_value())
+        {
+            const auto ttl = std::chrono::milliseconds(std::chrono::seconds(ttl_seconds.value()));
+            suppression.keepalive = std::min(suppression.keepalive, ttl / 2);
+        }
+        return suppression;
+    }
+
     void Set(const double& value) const
     {
-        auto line = this->ConstructLine(value);
-        Writer::GetInstance().Write(line);
+        if (this->IsUnchanged(value) == false)
+        {
+            this->Send(value);
+        }
     }
+
+   private:
+    friend class Registry;
+
+    // Used by the Registry to hand out meters that share cached state
+    explicit Gauge(MeterStatePtr state) : Meter(std::move(state)) {}
 };
 
 }  // namespace spectator
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <writer.h>
 
 #include <string>
+#include <utility>
 
 namespace spectator {
 
@@ -17,9 +18,14 @@ class MaxGauge final : public Meter
 
     void Set(const double& value) const
     {
-        auto line = this->ConstructLine(value);
-        Writer::GetInstance().Write(line);
+        this->Send(value);
     }
+
+   private:
+    friend class Registry;
+
+    // Used by the Registry to hand out meters that share cached state
+    explicit MaxGauge(MeterStatePtr state) : Meter(std::move(state)) {}
 };
 
 }  // namespace spectator
\ No newline at end of file
@@ -1,47 +1,159 @@
 #pragma once
 
+#include <change_filter.h>
 #include <meter_id.h>
+#include <util.h>
+#include <writer.h>
+
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
+#include <utility>
+
+#include <boost/smart_ptr/intrusive_ptr.hpp>
+#include <boost/smart_ptr/intrusive_ref_counter.hpp>
 
 namespace spectator {
 
-class Meter
+/**
+ * MeterState - The immutable state shared by every copy of a meter
+ *
+ * Holds the id (name, tags, formatted spectatord id and cached hash), the type symbol, the precomputed pieces of
+ * the protocol line, the writer that lines go to and, if the meter suppresses unchanged values, the last value sent.
+ * It is created once per meter and reference counted, so copying a meter only copies a pointer, and meters created
+ * through the Registry with the same type and id share one instance. Meters that keep more state than that, like
+ * sharded counters with their slots, extend it.
+ */
+class MeterState : public boost::intrusive_ref_counter<MeterState, boost::thread_safe_counter>
 {
    public:
     static constexpr auto FIELD_SEPARATOR = ":";
 
-    Meter(const MeterId& meter_id, const std::string& meter_type_symbol)
-        : m_id(meter_id), m_meterTypeSymbol(meter_type_symbol)
+    // Without a writer, lines go to the default writer
+    MeterState(const MeterId& meter_id, const std::string& meter_type_symbol,
+               std::shared_ptr<Writer> writer = nullptr,
+               const std::optional<ChangeSuppression>& suppression = std::nullopt)
+        : m_id(meter_id),
+          m_meterTypeSymbol(meter_type_symbol),
+          m_linePrefix(meter_type_symbol + FIELD_SEPARATOR + m_id.GetSpectatordId() + FIELD_SEPARATOR),
+          m_incrementLine(m_linePrefix + "1"),
+          m_writer(std::move(writer)),
+          m_changeFilter(suppression.has_value() ? std::make_unique<ChangeFilter>(*suppression) : nullptr)
     {
     }
-    virtual ~Meter() = default;
+
+    // Released through a MeterStatePtr, which may point to an extended state
+    virtual ~MeterState() = default;
+
+    MeterState(const MeterState&) = delete;
+    MeterState& operator=(const MeterState&) = delete;
 
     const MeterId& GetId() const noexcept { return m_id; }
 
     const std::string& GetMeterTypeSymbol() const noexcept { return m_meterTypeSymbol; }
-    
+
+    // The "symbol:id:" part of every protocol line
+    const std::string& GetLinePrefix() const noexcept { return m_linePrefix; }
+
+    // The complete line for a value of 1, which is what Counter::Increment() sends by default
+    const std::string& GetIncrementLine() const noexcept { return m_incrementLine; }
+
+    Writer& GetWriter() const noexcept { return m_writer != nullptr ? *m_writer : Writer::Default(); }
+
+    // Where a writer that defers formatting caches the id it gave the line prefix
+    std::atomic<uint64_t>& GetPrefixHandle() const noexcept { return m_prefixHandle; }
+
+    // Null unless the meter suppresses unchanged values
+    ChangeFilter* GetChangeFilter() const noexcept { return m_changeFilter.get(); }
+
+   private:
+    const MeterId m_id;
+    const std::string m_meterTypeSymbol;
+    const std::string m_linePrefix;
+    const std::string m_incrementLine;
+    // Shared, so that the writer outlives its Registry for as long as meters refer to it
+    const std::shared_ptr<Writer> m_writer;
+    mutable std::atomic<uint64_t> m_prefixHandle{0};
+    const std::unique_ptr<ChangeFilter> m_changeFilter;
+};
+
+using MeterStatePtr = boost::intrusive_ptr<const MeterState>;
+
+class Meter
+{
+   public:
+    static constexpr auto FIELD_SEPARATOR = MeterState::FIELD_SEPARATOR;
+
+    Meter(const MeterId& meter_id, const std::string& meter_type_symbol,
+          const std::optional<ChangeSuppression>& suppression = std::nullopt)
+        : m_state(new MeterState(meter_id, meter_type_symbol, nullptr, suppression))
+    {
+    }
+
+    explicit Meter(MeterStatePtr state) : m_state(std::move(state)) {}
+
+    const MeterId& GetId() const noexcept { return m_state->GetId(); }
+
+    const std::string& GetMeterTypeSymbol() const noexcept { return m_state->GetMeterTypeSymbol(); }
+
+    // The "symbol:id:" part of every protocol line, computed once when the meter state is created
+    const std::string& GetLinePrefix() const noexcept { return m_state->GetLinePrefix(); }
+
+    const MeterStatePtr& GetState() const noexcept { return m_state; }
+
+    // Longest value AppendValue can produce, e.g. -2.2250738585072014e-308
+    static constexpr size_t MAX_VALUE_LENGTH = 24;
+
     template <typename T>
     inline std::string ConstructLine(const T& value) const
     {
-        // Pre-calculate the required size to avoid reallocations
-        const auto& id_str = m_id.GetSpectatordId();
-        const auto value_str = std::to_string(value);
+        const auto& prefix = m_state->GetLinePrefix();
         std::string result;
-        result.reserve(m_meterTypeSymbol.size() + id_str.size() + value_str.size() + 2); // +2 for two separators
-        
-        // Build the string with append operations (more efficient than + operator)
-        result.append(m_meterTypeSymbol);
-        result.append(FIELD_SEPARATOR);
-        result.append(id_str);
-        result.append(FIELD_SEPARATOR);
-        result.append(value_str);
-        
+        result.reserve(prefix.size() + MAX_VALUE_LENGTH);
+        result.append(prefix);
+        AppendValue(result, value);
         return result;
     }
 
    protected:
-    MeterId m_id;
-    std::string m_meterTypeSymbol;
+    // Whether the meter suppresses unchanged values, and this one is close enough to the last one sent
+    bool IsUnchanged(double value) const noexcept
+    {
+        auto* filter = m_state->GetChangeFilter();
+        return filter != nullptr && filter->ShouldSend(value) == false;
+    }
+
+    // Sends the line for the value, or only the value if the writer formats lines on its sending thread
+    template <typename T>
+    void Send(const T& value) const
+    {
+        auto& writer = m_state->GetWriter();
+        if (writer.DefersFormatting() == false)
+        {
+            writer.Write(ConstructLine(value));
+        }
+        else if constexpr (std::floating_point<T>)
+        {
+            writer.WriteValue(m_state->GetPrefixHandle(), m_state->GetLinePrefix(), static_cast<double>(value));
+        }
+        else if constexpr (std::signed_integral<T>)
+        {
+            writer.WriteValue(m_state->GetPrefixHandle(), m_state->GetLinePrefix(), static_cast<int64_t>(value));
+        }
+        else
+        {
+            writer.WriteValue(m_state->GetPrefixHandle(), m_state->GetLinePrefix(), static_cast<uint64_t>(value));
+        }
+    }
+
+    // Meters are handles to their shared state and are never deleted through a base pointer, so the destructor is
+    // not virtual and a meter is the size of a single pointer
+    ~Meter() = default;
+
+    MeterStatePtr m_state;
 };
 
 }  // namespace spectator
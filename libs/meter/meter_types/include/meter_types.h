@@ -12,4 +12,5 @@
 #include "monotonic_counter_uint.h"
 #include "percentile_dist_summary.h"
 #include "percentile_timer.h"
+#include "sharded_counter.h"
 #include "timer.h"
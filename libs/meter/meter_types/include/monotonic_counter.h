@@ -5,6 +5,7 @@
 #include <writer.h>
 
 #include <string>
+#include <utility>
 
 namespace spectator {
 
@@ -15,11 +16,26 @@ class MonotonicCounter final : public Meter
    public:
     explicit MonotonicCounter(const MeterId& meter_id) : Meter(meter_id, MONOTONIC_COUNTER_TYPE_SYMBOL) {}
 
+    // Set only sends amounts that differ from the last one sent by more than the epsilon, or once the keepalive
+    // has passed. spectatord sees no increase while the amount is unchanged either way.
+    MonotonicCounter(const MeterId& meter_id, const ChangeSuppression& suppression)
+        : Meter(meter_id, MONOTONIC_COUNTER_TYPE_SYMBOL, suppression)
+    {
+    }
+
     void Set(const double& amount) const
     {
-        auto line = this->ConstructLine(amount);
-        Writer::GetInstance().Write(line);
+        if (this->IsUnchanged(amount) == false)
+        {
+            this->Send(amount);
+        }
     }
+
+   private:
+    friend class Registry;
+
+    // Used by the Registry to hand out meters that share cached state
+    explicit MonotonicCounter(MeterStatePtr state) : Meter(std::move(state)) {}
 };
 
 }  // namespace spectator
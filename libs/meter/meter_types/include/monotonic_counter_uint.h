@@ -5,6 +5,7 @@
 #include <writer.h>
 
 #include <string>
+#include <utility>
 
 namespace spectator {
 
@@ -17,9 +18,14 @@ class MonotonicCounterUint final : public Meter
 
     void Set(const uint64_t& amount) const
     {
-        auto line = this->ConstructLine(amount);
-        Writer::GetInstance().Write(line);
+        this->Send(amount);
     }
+
+   private:
+    friend class Registry;
+
+    // Used by the Registry to hand out meters that share cached state
+    explicit MonotonicCounterUint(MeterStatePtr state) : Meter(std::move(state)) {}
 };
 
 }  // namespace spectator
@@ -6,6 +6,7 @@
 
 #include <cstdint>
 #include <string>
+#include <utility>
 
 namespace spectator {
 
@@ -23,10 +24,15 @@ class PercentileDistributionSummary final : public Meter
     {
         if (amount >= 0)
         {
-            auto line = this->ConstructLine(amount);
-            Writer::GetInstance().Write(line);
+            this->Send(amount);
         }
     }
+
+   private:
+    friend class Registry;
+
+    // Used by the Registry to hand out meters that share cached state
+    explicit PercentileDistributionSummary(MeterStatePtr state) : Meter(std::move(state)) {}
 };
 
 }  // namespace spectator
@@ -5,6 +5,7 @@
 #include <writer.h>
 
 #include <string>
+#include <utility>
 
 namespace spectator {
 
@@ -19,10 +20,15 @@ class PercentileTimer final : public Meter
     {
         if (seconds >= 0)
         {
-            auto line = this->ConstructLine(seconds);
-            Writer::GetInstance().Write(line);
+            this->Send(seconds);
         }
     }
+
+   private:
+    friend class Registry;
+
+    // Used by the Registry to hand out meters that share cached state
+    explicit PercentileTimer(MeterStatePtr state) : Meter(std::move(state)) {}
 };
 
 }  // namespace spectator
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <counter.h>
+#include <meter.h>
+#include <meter_id.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace spectator {
+
+// The state of a sharded counter: the meter state, plus the slots that every copy adds to
+class ShardedCounterState final : public MeterState
+{
+   public:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t MAX_SLOTS = 64;
+
+    // One slot per hardware thread, up to MAX_SLOTS, so that threads rarely share one
+    explicit ShardedCounterState(const MeterId& meter_id, std::shared_ptr<Writer> writer = nullptr)
+        : MeterState(meter_id, COUNTER_TYPE_SYMBOL, std::move(writer)),
+          m_mask(std::bit_ceil(std::clamp<size_t>(std::thread::hardware_concurrency(), 1, MAX_SLOTS)) - 1),
+          m_slots(std::make_unique<Slot[]>(m_mask + 1))
+    {
+    }
+
+    void Add(double delta) const noexcept
+    {
+        m_slots[ThreadIndex() & m_mask].value.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    // Returns what was added since the last call
+    double TakeTotal() const noexcept
+    {
+        double total = 0;
+        for (size_t i = 0; i <= m_mask; i++)
+        {
+            total += m_slots[i].value.exchange(0, std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+   private:
+    struct alignas(CACHE_LINE_SIZE) Slot
+    {
+        std::atomic<double> value{0};
+    };
+
+    // Threads are numbered in the order they first increment a sharded counter
+    static size_t ThreadIndex() noexcept
+    {
+        static std::atomic<size_t> nextIndex{0};
+        thread_local const size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+    const size_t m_mask;
+    const std::unique_ptr<Slot[]> m_slots;
+};
+
+/**
+ * ShardedCounter - A counter that accumulates in memory and sends its total periodically
+ *
+ * Increment adds the delta to a slot of the calling thread with a relaxed atomic, and sends nothing. The slots are
+ * padded to a cache line each, so threads incrementing the same counter do not contend. Publish sums and resets the
+ * slots and sends the total as a single counter line, which spectatord adds up the same as the individual
+ * increments. Counters created by the Registry are published on its publishing interval and when it is flushed;
+ * counters constructed directly are only published when Publish is called.
+ *
+ * Copies share their slots, which live in the meter state, so a sharded counter is a single pointer like other meters.
+ */
+class ShardedCounter final : public Meter
+{
+   public:
+    explicit ShardedCounter(const MeterId& meter_id) : Meter(MeterStatePtr(new ShardedCounterState(meter_id))) {}
+
+    void Increment(const double& delta = 1) const
+    {
+        if (delta > 0)
+        {
+            GetShards().Add(delta);
+        }
+    }
+
+    // Sends what was added since the last call as one counter line, if anything was
+    void Publish() const
+    {
+        if (const auto total = GetShards().TakeTotal(); total > 0)
+        {
+            this->Send(total);
+        }
+    }
+
+   private:
+    friend class MeterPublisher;
+    friend class Registry;
+
+    // Used by the Registry to hand out counters that share cached state, which must be a ShardedCounterState
+    explicit ShardedCounter(MeterStatePtr state) : Meter(std::move(state)) {}
+
+    const ShardedCounterState& GetShards() const noexcept { return static_cast<const ShardedCounterState&>(*m_state); }
+
+    // Whether anything but the publisher, e.g. a handle or the meter cache, still refers to the counter
+    bool IsShared() const noexcept { return m_state->use_count() > 1; }
+};
+
+}  // namespace spectator
@@ -19,9 +19,9 @@ TEST_F(CounterTest, increment)
     Counter c(tid);
     EXPECT_TRUE(writer->IsEmpty());
     c.Increment();
-    EXPECT_EQ("c:counter:1.000000\n", writer->LastLine());
+    EXPECT_EQ("c:counter:1\n", writer->LastLine());
     c.Increment(2);
-    EXPECT_EQ("c:counter:2.000000\n", writer->LastLine());
+    EXPECT_EQ("c:counter:2\n", writer->LastLine());
 }
 
 TEST_F(CounterTest, incrementNegative)
@@ -32,4 +32,27 @@ TEST_F(CounterTest, incrementNegative)
     Counter c(tid);
     c.Increment(-1);
     EXPECT_TRUE(writer->IsEmpty());
-}
\ No newline at end of file
+}
+
+TEST_F(CounterTest, linePrefix)
+{
+    WriterTestHelper::InitializeWriter(WriterType::Memory);
+    const auto* writer = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+
+    Counter c(MeterId("counter", {{"a", "1"}}));
+    EXPECT_EQ("c:counter,a=1:", c.GetLinePrefix());
+    c.Increment();
+    EXPECT_EQ("c:counter,a=1:1\n", writer->LastLine());
+    c.Increment(1.5);
+    EXPECT_EQ("c:counter,a=1:1.5\n", writer->LastLine());
+}
+
+TEST_F(CounterTest, copiesShareState)
+{
+    static_assert(sizeof(Counter) == sizeof(void*));
+
+    Counter c1(tid);
+    const Counter c2 = c1;
+    EXPECT_EQ(c1.GetState(), c2.GetState());
+    EXPECT_EQ(2, c1.GetState()->use_count());
+}
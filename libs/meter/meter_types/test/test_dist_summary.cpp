@@ -19,7 +19,7 @@ TEST_F(DistSummaryTest, record)
     EXPECT_TRUE(writer->IsEmpty());
 
     ds.Record(42);
-    EXPECT_EQ("d:dist_summary:42.000000\n", writer->LastLine());
+    EXPECT_EQ("d:dist_summary:42\n", writer->LastLine());
 }
 
 TEST_F(DistSummaryTest, recordNegative)
@@ -41,5 +41,5 @@ TEST_F(DistSummaryTest, recordZero)
     EXPECT_TRUE(writer->IsEmpty());
 
     ds.Record(0);
-    EXPECT_EQ("d:dist_summary:0.000000\n", writer->LastLine());
+    EXPECT_EQ("d:dist_summary:0\n", writer->LastLine());
 }
\ No newline at end of file
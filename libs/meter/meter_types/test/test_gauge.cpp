@@ -3,6 +3,9 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <thread>
+
 using namespace spectator;
 
 class GaugeTest : public testing::Test
@@ -18,7 +21,7 @@ TEST_F(GaugeTest, Now)
     Gauge g(tid);
     EXPECT_TRUE(writer->IsEmpty());
     g.Set(1);
-    EXPECT_EQ("g:gauge:1.000000\n", writer->LastLine());
+    EXPECT_EQ("g:gauge:1\n", writer->LastLine());
 }
 
 TEST_F(GaugeTest, TTL)
@@ -28,5 +31,71 @@ TEST_F(GaugeTest, TTL)
     Gauge g(tid, 10);
     EXPECT_TRUE(writer->IsEmpty());
     g.Set(42);
-    EXPECT_EQ("g,10:gauge:42.000000\n", writer->LastLine());
-}
\ No newline at end of file
+    EXPECT_EQ("g,10:gauge:42\n", writer->LastLine());
+}
+
+TEST_F(GaugeTest, ShortestRoundTrip)
+{
+    WriterTestHelper::InitializeWriter(WriterType::Memory);
+    const auto* writer = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    Gauge g(tid);
+
+    g.Set(0.1);
+    EXPECT_EQ("g:gauge:0.1\n", writer->LastLine());
+    g.Set(-2.5);
+    EXPECT_EQ("g:gauge:-2.5\n", writer->LastLine());
+    g.Set(123456789);
+    EXPECT_EQ("g:gauge:123456789\n", writer->LastLine());
+    g.Set(1e21);
+    EXPECT_EQ("g:gauge:1e+21\n", writer->LastLine());
+    g.Set(1.0 / 3);
+    EXPECT_EQ("g:gauge:0.3333333333333333\n", writer->LastLine());
+}
+
+TEST_F(GaugeTest, SuppressesUnchangedValues)
+{
+    WriterTestHelper::InitializeWriter(WriterType::Memory);
+    const auto* writer = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    ChangeSuppression suppression{};
+    suppression.epsilon = 0.5;
+    Gauge g(tid, std::nullopt, suppression);
+
+    g.Set(1);
+    g.Set(1);
+    g.Set(1.5);
+    EXPECT_EQ(1u, writer->GetMessages().size());
+
+    // Compared with the last value sent, so small steps still add up
+    g.Set(1.75);
+    EXPECT_EQ(2u, writer->GetMessages().size());
+    EXPECT_EQ("g:gauge:1.75\n", writer->LastLine());
+}
+
+TEST_F(GaugeTest, SuppressionKeepsGaugeAlive)
+{
+    WriterTestHelper::InitializeWriter(WriterType::Memory);
+    const auto* writer = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    ChangeSuppression suppression{};
+    suppression.keepalive = std::chrono::milliseconds(20);
+    Gauge g(tid, std::nullopt, suppression);
+
+    g.Set(42);
+    g.Set(42);
+    EXPECT_EQ(1u, writer->GetMessages().size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    g.Set(42);
+    EXPECT_EQ(2u, writer->GetMessages().size());
+}
+
+TEST_F(GaugeTest, SuppressionKeepaliveIsWithinTtl)
+{
+    const auto suppression = Gauge::WithinTtl(ChangeSuppression{}, 10);
+    EXPECT_EQ(std::chrono::milliseconds(5000), suppression.keepalive);
+    EXPECT_EQ(ChangeSuppression::DefaultKeepalive, Gauge::WithinTtl(ChangeSuppression{}, std::nullopt).keepalive);
+
+    // Long TTLs do not overflow into a negative keepalive
+    ChangeSuppression longKeepalive{};
+    longKeepalive.keepalive = std::chrono::hours(24 * 30);
+    EXPECT_EQ(std::chrono::milliseconds(std::chrono::seconds(30 * 24 * 3600)) / 2,
+              Gauge::WithinTtl(longKeepalive, 30 * 24 * 3600).keepalive);
+}
@@ -18,5 +18,5 @@ TEST_F(MaxGaugeTest, Set)
     MaxGauge g(tid);
     EXPECT_TRUE(writer->IsEmpty());
     g.Set(0);
-    EXPECT_EQ("m:max_gauge:0.000000\n", writer->LastLine());
+    EXPECT_EQ("m:max_gauge:0\n", writer->LastLine());
 }
\ No newline at end of file
@@ -18,7 +18,7 @@ TEST_F(MonotonicCounterTest, SetValue)
     MonotonicCounter mc(tid);
     EXPECT_TRUE(writer->IsEmpty());
     mc.Set(1);
-    EXPECT_EQ("C:monotonic_counter:1.000000\n", writer->LastLine());
+    EXPECT_EQ("C:monotonic_counter:1\n", writer->LastLine());
 }
 
 TEST_F(MonotonicCounterTest, SetNegativeValue)
@@ -28,5 +28,20 @@ TEST_F(MonotonicCounterTest, SetNegativeValue)
     MonotonicCounter mc(tid);
     EXPECT_TRUE(writer->IsEmpty());
     mc.Set(-1);
-    EXPECT_EQ("C:monotonic_counter:-1.000000\n", writer->LastLine());
-}
\ No newline at end of file
+    EXPECT_EQ("C:monotonic_counter:-1\n", writer->LastLine());
+}
+
+TEST_F(MonotonicCounterTest, SuppressesUnchangedAmounts)
+{
+    WriterTestHelper::InitializeWriter(WriterType::Memory);
+    const auto* writer = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    MonotonicCounter mc(tid, ChangeSuppression{});
+
+    mc.Set(10);
+    mc.Set(10);
+    mc.Set(10);
+    EXPECT_EQ(1u, writer->GetMessages().size());
+    mc.Set(11);
+    EXPECT_EQ(2u, writer->GetMessages().size());
+    EXPECT_EQ("C:monotonic_counter:11\n", writer->LastLine());
+}
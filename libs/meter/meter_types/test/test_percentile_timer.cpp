@@ -19,7 +19,7 @@ TEST_F(PercentileTimerTest, record)
     EXPECT_TRUE(writer->IsEmpty());
 
     pt.Record(42);
-    EXPECT_EQ("T:percentile_timer:42.000000\n", writer->LastLine());
+    EXPECT_EQ("T:percentile_timer:42\n", writer->LastLine());
 }
 
 TEST_F(PercentileTimerTest, recordNegative)
@@ -41,5 +41,18 @@ TEST_F(PercentileTimerTest, recordZero)
     EXPECT_TRUE(writer->IsEmpty());
 
     pt.Record(0);
-    EXPECT_EQ("T:percentile_timer:0.000000\n", writer->LastLine());
-}
\ No newline at end of file
+    EXPECT_EQ("T:percentile_timer:0\n", writer->LastLine());
+}
+
+TEST_F(PercentileTimerTest, recordSubMicrosecond)
+{
+    WriterTestHelper::InitializeWriter(WriterType::Memory);
+    const auto* writer = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    PercentileTimer pt(tid);
+
+    pt.Record(0.0000005);
+    EXPECT_EQ("T:percentile_timer:5e-07\n", writer->LastLine());
+
+    pt.Record(0.001234);
+    EXPECT_EQ("T:percentile_timer:0.001234\n", writer->LastLine());
+}
@@ -0,0 +1,79 @@
+#include <sharded_counter.h>
+#include <writer_test_helper.h>
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+using namespace spectator;
+
+class ShardedCounterTest : public testing::Test
+{
+   protected:
+    MeterId tid = MeterId("sharded");
+};
+
+TEST_F(ShardedCounterTest, incrementSendsNothing)
+{
+    WriterTestHelper::InitializeWriter(WriterType::Memory);
+    const auto* writer = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+
+    ShardedCounter c(tid);
+    c.Increment();
+    c.Increment(2);
+    EXPECT_TRUE(writer->IsEmpty());
+
+    c.Publish();
+    EXPECT_EQ("c:sharded:3\n", writer->LastLine());
+}
+
+TEST_F(ShardedCounterTest, publishResets)
+{
+    WriterTestHelper::InitializeWriter(WriterType::Memory);
+    const auto* writer = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+
+    ShardedCounter c(tid);
+    c.Publish();
+    EXPECT_TRUE(writer->IsEmpty());
+
+    c.Increment(-1);
+    c.Increment(0);
+    c.Publish();
+    EXPECT_TRUE(writer->IsEmpty());
+
+    c.Increment(1.5);
+    c.Publish();
+    c.Publish();
+    EXPECT_EQ(1u, writer->GetMessages().size());
+    EXPECT_EQ("c:sharded:1.5\n", writer->LastLine());
+}
+
+TEST_F(ShardedCounterTest, copiesShareTheirSlots)
+{
+    WriterTestHelper::InitializeWriter(WriterType::Memory);
+    const auto* writer = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+
+    static_assert(sizeof(ShardedCounter) == sizeof(void*));
+
+    ShardedCounter c(tid);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++)
+    {
+        threads.emplace_back(
+            [copy = c]
+            {
+                for (int i = 0; i < 10000; i++)
+                {
+                    copy.Increment();
+                }
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    c.Publish();
+    EXPECT_EQ("c:sharded:80000\n", writer->LastLine());
+}
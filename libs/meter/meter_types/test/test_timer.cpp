@@ -19,7 +19,7 @@ TEST_F(TimerTest, record)
     EXPECT_TRUE(writer->IsEmpty());
 
     t.Record(42);
-    EXPECT_EQ("t:timer:42.000000\n", writer->LastLine());
+    EXPECT_EQ("t:timer:42\n", writer->LastLine());
 }
 
 TEST_F(TimerTest, recordNegative)
@@ -41,5 +41,5 @@ TEST_F(TimerTest, recordZero)
     EXPECT_TRUE(writer->IsEmpty());
 
     t.Record(0);
-    EXPECT_EQ("t:timer:0.000000\n", writer->LastLine());
+    EXPECT_EQ("t:timer:0\n", writer->LastLine());
 }
\ No newline at end of file
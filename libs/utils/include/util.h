@@ -1,5 +1,9 @@
 # pragma once
 
+#include <charconv>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -26,23 +30,11 @@ struct ProtocolLine
         std::stringstream ss;
         ss << symbol << ":" << id.GetName();
 
-        // Sort tags by key
-        std::map<std::string, std::string> sorted_tags(id.GetTags().begin(), id.GetTags().end());
-
-        // Add tags if there are any
-        if (!sorted_tags.empty())
+        // Tags are kept sorted by key
+        for (size_t i = 0; i < id.GetTagCount(); i++)
         {
-            ss << ",";
-            bool first = true;
-            for (const auto& [key, value] : sorted_tags)
-            {
-                if (!first)
-                {
-                    ss << ",";
-                }
-                ss << key << "=" << value;
-                first = false;
-            }
+            const auto [tagKey, tagValue] = id.GetTag(i);
+            ss << "," << tagKey << "=" << tagValue;
         }
 
         // Add the value
@@ -52,6 +44,31 @@ struct ProtocolLine
     }
 };
 
+// Appends the decimal representation of an integer value
+template <std::integral T>
+inline void AppendValue(std::string& out, T value)
+{
+    char buf[24];
+    const auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+}
+
+// Appends the shortest representation of value that parses back to the same double, independent of the locale.
+// Whole numbers small enough to be exact take the integer path, so 1.0 is written as "1".
+inline void AppendValue(std::string& out, double value)
+{
+    constexpr double MAX_EXACT_INTEGER = 9007199254740992.0;  // 2^53
+    if (std::trunc(value) == value && std::fabs(value) < MAX_EXACT_INTEGER)
+    {
+        AppendValue(out, static_cast<int64_t>(value));
+        return;
+    }
+
+    char buf[32];
+    const auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+}
+
 std::optional<ProtocolLine> ParseProtocolLine(const std::string& line);
 
 bool IsEmptyOrWhitespace(const std::string& str);
@@ -52,8 +52,8 @@ WriterConfig::WriterConfig(const std::string& type)
 WriterConfig::WriterConfig(const std::string& type, const unsigned int bufferSize)
     : WriterConfig(type)  // Constructor delegation
 {
-    m_bufferSize = bufferSize;
-    Logger::info("WriterConfig buffering enabled with size: {}", m_bufferSize);
+    m_options.bufferSize = bufferSize;
+    Logger::info("WriterConfig buffering enabled with size: {}", m_options.bufferSize);
 }
 
 }  // namespace spectator
\ No newline at end of file
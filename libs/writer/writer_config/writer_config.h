@@ -2,6 +2,7 @@
 
 #include <writer_types.h>
 
+#include <chrono>
 #include <string>
 #include <stdexcept>
 
@@ -14,13 +15,55 @@ class WriterConfig
     WriterConfig(const std::string& type, unsigned int bufferSize);
 
     [[nodiscard]] const WriterType& GetType() const noexcept { return m_type; }
-    [[nodiscard]] unsigned int GetBufferSize() const noexcept { return m_bufferSize; }
+    [[nodiscard]] unsigned int GetBufferSize() const noexcept { return m_options.bufferSize; }
     [[nodiscard]] const std::string& GetLocation() const noexcept { return m_location; }
+    [[nodiscard]] const WriterOptions& GetOptions() const noexcept { return m_options; }
+
+    // Only takes effect when a buffer size is set. Each thread then buffers its own lines, and buffers that are not
+    // full are swept and sent every flush interval.
+    void SetThreadLocalBuffers(bool enabled) noexcept { m_options.threadLocalBuffers = enabled; }
+    void SetFlushInterval(std::chrono::milliseconds interval) noexcept { m_options.flushInterval = interval; }
+
+    // Only takes effect when a buffer size is set. Buffered lines are sent once the oldest has waited this long,
+    // even if the buffer is not full.
+    void SetMaxLinger(std::chrono::milliseconds maxLinger) noexcept { m_options.maxLinger = maxLinger; }
+
+    // Only takes effect with a buffer size and without thread-local buffers. Meters enqueue their values, and the
+    // protocol lines are formatted on the sending thread instead of the thread recording the value.
+    void SetDeferFormatting(bool enabled) noexcept { m_options.deferFormatting = enabled; }
+
+    // How many meter prefixes the sending thread keeps for deferred formatting. Meters created beyond that are
+    // formatted on the recording thread. Defaults to the meter cache size of the Config.
+    void SetMaxDeferredPrefixes(size_t maxPrefixes) noexcept { m_options.maxDeferredPrefixes = maxPrefixes; }
+
+    // Only takes effect when a buffer size is set. Counters, gauges and max gauges updated several times within a
+    // batch are sent as a single line, with the sum of the deltas, the last value or the largest value.
+    void SetCoalesce(bool enabled) noexcept { m_options.coalesce = enabled; }
+
+    // Buffered lines are sent in datagrams of at most this many bytes, and a line is never split between two. Use
+    // DatagramPacker::MtuUdpPayload when sending UDP to another host.
+    void SetMaxDatagramSize(size_t maxDatagramSize) noexcept { m_options.maxDatagramSize = maxDatagramSize; }
+
+    // Linux only, for UDP writers with a buffer size. Batches are handed to the kernel in one send and split into
+    // datagrams of this many bytes by UDP generic segmentation offload; lines are padded so none straddles two.
+    void SetUdpSegmentSize(size_t segmentSize) noexcept { m_options.udpSegmentSize = segmentSize; }
+
+    // Linux only. UDP and Unix domain socket writers submit their sends through io_uring, one system call per batch
+    // of datagrams. Falls back to the regular writers on kernels without io_uring.
+    void SetIoUring(bool enabled) noexcept { m_options.ioUring = enabled; }
+
+    // Whether a full buffer makes producers wait, or drops lines. Dropped lines are counted in
+    // Registry::GetWriterStats.
+    void SetOverflowPolicy(OverflowPolicy policy) noexcept { m_options.overflowPolicy = policy; }
+    void SetSendBufferSize(int bytes) noexcept { m_options.sendBufferSize = bytes; }
+
+    // When the writer is shut down, e.g. on exit, buffered lines are sent for up to this long
+    void SetShutdownTimeout(std::chrono::milliseconds timeout) noexcept { m_options.shutdownTimeout = timeout; }
 
    private:
     WriterType m_type;
     std::string m_location;
-    unsigned int m_bufferSize = 0;
+    WriterOptions m_options;
 };
 
 }  // namespace spectator
\ No newline at end of file
@@ -1,9 +1,28 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
 #include <string>
+#include <string_view>
 
 namespace spectator {
 
+// Options for the sockets of the UDP and Unix domain socket writers
+struct SocketOptions
+{
+    // A send that would block is dropped instead of waiting for room in the socket buffer
+    bool nonBlocking = false;
+
+    // SO_SNDBUF in bytes. 0 keeps the system default.
+    int sendBufferSize = 0;
+
+    // UDP only. Above 0, batches are sent with generic segmentation offload in segments of this many bytes.
+    size_t udpSegmentSize = 0;
+};
+
 class BaseWriter
 {
    public:
@@ -16,7 +35,65 @@ class BaseWriter
     BaseWriter& operator=(BaseWriter&&) = delete;
 
     virtual void Write(const std::string& message) = 0;
+
+    // Sends each message as its own datagram
+    virtual void WriteBatch(std::span<const std::string> messages)
+    {
+        for (const auto& message : messages)
+        {
+            Write(message);
+        }
+    }
+
     virtual void Close() = 0;
+
+    // Called in a forked child before the writer it inherited is destroyed. Its sockets are shared with the parent,
+    // so this closes the child's copies without waiting for anything or taking locks the parent may have held.
+    virtual void CloseAfterFork() {}
+
+    // Datagrams and bytes this writer handed to the transport
+    uint64_t GetSentDatagrams() const noexcept { return m_sentDatagrams.load(std::memory_order_relaxed); }
+    uint64_t GetSentBytes() const noexcept { return m_sentBytes.load(std::memory_order_relaxed); }
+
+    // Lines and bytes this writer could not send, e.g. because the socket buffer was full or the socket failed
+    uint64_t GetDroppedLines() const noexcept { return m_droppedLines.load(std::memory_order_relaxed); }
+    uint64_t GetDroppedBytes() const noexcept { return m_droppedBytes.load(std::memory_order_relaxed); }
+
+   protected:
+    void RecordSent(std::string_view datagram) noexcept
+    {
+        m_sentDatagrams.fetch_add(1, std::memory_order_relaxed);
+        m_sentBytes.fetch_add(datagram.size(), std::memory_order_relaxed);
+    }
+
+    void RecordSent(std::span<const std::string> datagrams) noexcept
+    {
+        for (const auto& datagram : datagrams)
+        {
+            RecordSent(datagram);
+        }
+    }
+
+    void RecordDrop(std::string_view message) noexcept
+    {
+        const auto lines = std::count(message.begin(), message.end(), '\n');
+        m_droppedLines.fetch_add(std::max<uint64_t>(lines, 1), std::memory_order_relaxed);
+        m_droppedBytes.fetch_add(message.size(), std::memory_order_relaxed);
+    }
+
+    void RecordDrops(std::span<const std::string> messages) noexcept
+    {
+        for (const auto& message : messages)
+        {
+            RecordDrop(message);
+        }
+    }
+
+   private:
+    std::atomic<uint64_t> m_sentDatagrams{0};
+    std::atomic<uint64_t> m_sentBytes{0};
+    std::atomic<uint64_t> m_droppedLines{0};
+    std::atomic<uint64_t> m_droppedBytes{0};
 };
 
-}  // namespace spectator
\ No newline at end of file
+}  // namespace spectator
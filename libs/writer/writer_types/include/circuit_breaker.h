@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace spectator {
+
+/**
+ * CircuitBreaker - Stops a writer from hammering a sidecar that is not there
+ *
+ * After a number of consecutive failed writes the circuit opens, and writes are refused without touching the socket
+ * until a backoff has passed. The first write after that is let through as a probe: if it succeeds the circuit
+ * closes, and if it fails the backoff doubles, up to a maximum. Writers report why a write failed through the
+ * breaker instead of logging it, so that one line is logged for the first failure in a row, one when the circuit
+ * opens, one per failed probe and a summary of the refused writes when it closes, instead of an error per message.
+ *
+ * Checking a closed circuit is a single relaxed atomic load, so healthy writers pay nothing for it.
+ */
+class CircuitBreaker
+{
+   public:
+    using Clock = std::function<std::chrono::steady_clock::time_point()>;
+
+    static constexpr unsigned DefaultFailureThreshold = 3;
+    static constexpr std::chrono::milliseconds DefaultInitialBackoff{100};
+    static constexpr std::chrono::milliseconds DefaultMaxBackoff{30000};
+
+    // The name prefixes the log lines, e.g. "UDS Writer /run/spectatord/spectatord.unix". An empty clock uses
+    // std::chrono::steady_clock.
+    explicit CircuitBreaker(std::string name, unsigned failureThreshold = DefaultFailureThreshold,
+                            std::chrono::milliseconds initialBackoff = DefaultInitialBackoff,
+                            std::chrono::milliseconds maxBackoff = DefaultMaxBackoff, Clock clock = {});
+
+    // Returns whether the write should be attempted. False means the circuit is open and the write is refused.
+    bool AllowWrite();
+
+    void RecordSuccess();
+
+    // The reason is logged for the first failure in a row and for failed probes
+    void RecordFailure(std::string_view reason = {});
+
+    bool IsOpen() const noexcept { return m_open.load(std::memory_order_relaxed); }
+
+   private:
+    std::chrono::steady_clock::time_point Now() const;
+
+    const std::string m_name;
+    const unsigned m_failureThreshold;
+    const std::chrono::milliseconds m_initialBackoff;
+    const std::chrono::milliseconds m_maxBackoff;
+    const Clock m_clock;
+
+    std::atomic<bool> m_open{false};
+    std::atomic<unsigned> m_failures{0};  // Consecutive failures, only written under m_mutex
+
+    // Guarded by m_mutex
+    std::mutex m_mutex;
+    std::chrono::milliseconds m_backoff;
+    std::chrono::steady_clock::time_point m_retryAt{};
+    bool m_probing = false;
+    uint64_t m_refused = 0;
+};
+
+}  // namespace spectator
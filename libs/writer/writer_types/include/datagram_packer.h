@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace spectator {
+
+/**
+ * DatagramPacker - Packs newline-terminated lines into datagrams of at most a maximum payload size
+ *
+ * Lines are never split across datagrams, because spectatord parses every datagram on its own. A line that is
+ * longer than the maximum payload by itself still gets a datagram of its own, and the transport reports the error.
+ * The datagram strings are kept between batches, so a packer that is reused does not allocate once warmed up.
+ */
+class DatagramPacker
+{
+   public:
+    // Largest payload of a single UDP datagram over IPv4
+    static constexpr size_t MaxUdpPayload = 65507;
+
+    // Largest UDP payload that is not fragmented on an Ethernet path with a 1500 byte MTU
+    static constexpr size_t MtuUdpPayload = 1472;
+
+    explicit DatagramPacker(size_t maxPayload = MaxUdpPayload);
+
+    // Adds one line, without its trailing newline
+    void Add(std::string_view line);
+
+    // Adds a block of newline-terminated lines
+    void AddLines(std::string_view lines);
+
+    void Clear() noexcept;
+
+    bool IsEmpty() const noexcept { return m_count == 0; }
+
+    size_t GetMaxPayload() const noexcept { return m_maxPayload; }
+
+    // Every datagram packed since the last Clear, each ending with a newline
+    std::span<const std::string> Datagrams() const noexcept { return {m_datagrams.data(), m_count}; }
+
+   private:
+    // The datagram that has room for size more bytes, starting a new one if the current one is full
+    std::string& DatagramFor(size_t size);
+
+    size_t m_maxPayload;
+    size_t m_count = 0;
+    std::vector<std::string> m_datagrams;
+};
+
+}  // namespace spectator
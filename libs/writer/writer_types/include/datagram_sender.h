@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <boost/system/error_code.hpp>
+
+namespace spectator {
+
+// Sends each message as one datagram from the socket fd to the destination address, which may be null for a
+// connected socket. On Linux, messages are submitted in batches with sendmmsg, so a batch costs one system call
+// rather than one per datagram. Returns how many messages were sent, in order. If that is fewer than all of them,
+// ec holds the error that stopped the next one.
+size_t SendDatagrams(int fd, const void* destination, size_t destinationSize, std::span<const std::string> messages,
+                     boost::system::error_code& ec);
+
+// Whether a send failed because of the datagram rather than the socket, e.g. one larger than the socket accepts. Such
+// a datagram is dropped on its own, and the messages after it are still sent.
+bool IsDatagramError(const boost::system::error_code& ec) noexcept;
+
+// Largest number of segments the kernel accepts in one UDP_SEGMENT send
+static constexpr size_t MAX_UDP_SEGMENTS = 64;
+
+// Whether the UDP socket fd can send with generic segmentation offload (UDP_SEGMENT, Linux 4.18 and later)
+bool UdpSegmentationSupported(int fd, size_t segmentSize);
+
+// Sends the buffer from the UDP socket fd as consecutive datagrams of segmentSize bytes, the last one possibly
+// shorter, in one system call. Returns false and sets ec if the kernel rejected the send.
+bool SendSegmented(int fd, const void* destination, size_t destinationSize, std::string_view buffer,
+                   size_t segmentSize, boost::system::error_code& ec);
+
+}  // namespace spectator
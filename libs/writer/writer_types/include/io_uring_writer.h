@@ -0,0 +1,125 @@
+#pragma once
+
+#include <base_writer.h>
+#include <circuit_breaker.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace spectator {
+
+/**
+ * IoUringWriter - Sends datagrams over UDP or a Unix domain socket through io_uring (Linux 5.6 and later)
+ *
+ * Each message is copied into one of a fixed set of buffers registered with the kernel, and a batch of sends is
+ * submitted with a single system call that does not wait for them. Most sends complete within that call; one that
+ * finds the socket buffer full completes once there is room, while the caller carries on. Completions are collected
+ * by later writes, which free the buffers and count the datagrams as sent or dropped, and a write only waits when
+ * every buffer is still in flight. Sends within one submission are linked so that they go out in order.
+ *
+ * The kernel cancels the sends of a thread that exits, so those are submitted again by the next write, or by Close,
+ * which waits for every send in flight. The ring has a single submitter, so concurrent writes, e.g. from application
+ * threads when the Writer is not buffered, take turns submitting but do not wait for each other's sends.
+ *
+ * Use IsSupported() to check that the running kernel allows io_uring and has the send operations it uses before
+ * creating one.
+ */
+class IoUringWriter final : public BaseWriter
+{
+   public:
+    // Non-blocking sockets drop a datagram that finds the socket buffer full, as the UDP and UDS writers do. The UDP
+    // segment size is not used.
+    IoUringWriter(const std::string& host, int port, const SocketOptions& options = {});
+    explicit IoUringWriter(const std::string& socketPath, const SocketOptions& options = {});
+    ~IoUringWriter() override;
+
+    void Write(const std::string& message) override;
+    void WriteBatch(std::span<const std::string> messages) override;
+
+    // Waits for the sends in flight to complete, then closes the socket. The next write opens it again.
+    void Close() override;
+
+    // Closes the socket and unmaps the ring, leaving the parent's sends in flight alone
+    void CloseAfterFork() override;
+
+    static bool IsSupported();
+
+   private:
+    static constexpr unsigned QUEUE_DEPTH = 64;
+    static constexpr size_t NUM_BUFFERS = 16;
+    static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+    bool SetupRing();
+    void TearDownRing();
+    bool CreateSocket();
+    void CloseSocket();
+
+    // Waits for the sends in flight to complete, then closes the socket. Only call it with m_mutex held.
+    void DrainAndCloseSocket();
+
+    // Queues and submits the messages, waiting only for buffers to become free. Returns false if the ring failed.
+    bool Submit(std::span<const std::string> messages);
+
+    // Queues a send of the message in the buffer, linked to the previous one if there is one
+    io_uring_sqe* Queue(uint16_t index, io_uring_sqe* previous);
+
+    // Queues the sends that the kernel cancelled. Returns how many were queued.
+    unsigned QueueRetries();
+
+    // Submits the queued sends and waits until at least minComplete sends have completed
+    bool Enter(unsigned toSubmit, unsigned minComplete);
+
+    // Frees the buffers of the completed sends, and counts each one as sent or dropped. Cancelled sends keep their
+    // buffers, to be queued again.
+    void ReapCompletions();
+
+    // Held by writes and Close, as the submission queue and the free buffers are not shared
+    std::mutex m_mutex;
+
+    std::string m_description;
+    SocketOptions m_options;
+    CircuitBreaker m_breaker;
+    std::string m_lastError;  // Of the last failed attempt, reported through the breaker. Guarded by m_mutex.
+    sockaddr_storage m_address{};
+    socklen_t m_addressSize = 0;
+    int m_socket = -1;
+    bool m_socketEstablished = false;
+
+    int m_ringFd = -1;
+    void* m_sqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    void* m_cqRing = nullptr;
+    size_t m_cqRingSize = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned* m_sqArray = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned m_sqEntries = 0;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    io_uring_cqe* m_cqes = nullptr;
+
+    // Registered send buffers. If the kernel refuses to register them, e.g. because of RLIMIT_MEMLOCK, the same
+    // buffers are used for plain sends.
+    std::unique_ptr<char[]> m_buffers;
+    std::vector<uint16_t> m_freeBuffers;
+    std::array<uint32_t, NUM_BUFFERS> m_messageSizes{};  // Of the message in each buffer
+    std::vector<uint16_t> m_retries;  // Buffers whose sends were cancelled
+    bool m_fixedBuffers = false;
+    unsigned m_inFlight = 0;  // Buffers that are not free, including those waiting to be sent again
+};
+
+}  // namespace spectator
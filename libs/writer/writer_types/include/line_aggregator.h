@@ -0,0 +1,63 @@
+#pragma once
+
+#include <datagram_packer.h>
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace spectator {
+
+/**
+ * LineAggregator - Coalesces the updates of a meter within a batch into a single protocol line
+ *
+ * Counter deltas are summed, and gauges and max gauges keep their last and largest value, which is what spectatord
+ * would make of the individual lines. Lines of other meter types, whose every sample counts, are not taken, and the
+ * caller sends them as they are. Meters are keyed by their "symbol:id:" prefix and come out in the order they were
+ * first seen.
+ */
+class LineAggregator
+{
+   public:
+    // Takes a line, without its trailing newline. Returns false if it is not a counter, gauge or max gauge update.
+    bool Add(std::string_view line);
+
+    // Takes the value for a meter whose prefix is already known, e.g. from a deferred record
+    bool Add(std::string_view prefix, double value);
+
+    bool IsEmpty() const noexcept { return m_entries.empty(); }
+
+    // Adds one line per meter to the packer, and starts a new batch
+    void Flush(DatagramPacker& packer);
+
+   private:
+    enum class Kind
+    {
+        Sum,
+        Last,
+        Max
+    };
+
+    struct Entry
+    {
+        std::string prefix;
+        Kind kind;
+        double value;
+    };
+
+    struct PrefixHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view prefix) const noexcept { return std::hash<std::string_view>{}(prefix); }
+    };
+
+    // Positions in m_entries, which is in the order the meters were first seen
+    std::unordered_map<std::string, size_t, PrefixHash, std::equal_to<>> m_index;
+    std::vector<Entry> m_entries;
+    std::string m_line;
+};
+
+}  // namespace spectator
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <base_writer.h>
+#include <circuit_breaker.h>
+#include <datagram_packer.h>
 
 #include <memory>
 #include <string>
@@ -11,10 +13,15 @@ namespace spectator {
 class UDPWriter final : public BaseWriter
 {
    public:
-    UDPWriter(const std::string& host, int port);
+    // A UDP segment size above 0 sends batches with UDP generic segmentation offload: lines are packed into segments of
+    // that size, each padded with newlines so that no line straddles two datagrams, and up to 64 segments go to the
+    // kernel in one send. If the kernel does not support it, batches are sent as plain datagrams.
+    UDPWriter(const std::string& host, int port, const SocketOptions& options = {});
     ~UDPWriter() override;
     void Write(const std::string& message) override;
+    void WriteBatch(std::span<const std::string> messages) override;
     void Close() override;
+    void CloseAfterFork() override;
 
    private:
     std::string m_host;
@@ -23,9 +30,17 @@ class UDPWriter final : public BaseWriter
     std::unique_ptr<boost::asio::ip::udp::socket> m_socket;
     boost::asio::ip::udp::endpoint m_endpoint;
     bool m_socketEstablished;
-    
-    bool CreateSocket();
-    bool TryToSend(const std::string& message);
+    SocketOptions m_options;
+    CircuitBreaker m_breaker;
+    size_t m_segmentSize;
+    DatagramPacker m_segmentPacker;
+    std::string m_segmentBuffer;
+
+    // Each returns false on failure, with the reason in error for the circuit breaker to report
+    bool CreateSocket(std::string& error);
+    bool TryToSend(const std::string& message, std::string& error);
+    bool TryToSendBatch(std::span<const std::string> messages, std::string& error);
+    bool TryToSendSegmented(std::span<const std::string> messages, std::string& error);
 };
 
 }  // namespace spectator
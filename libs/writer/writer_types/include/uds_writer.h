@@ -1,6 +1,7 @@
 #pragma once
 
 #include <base_writer.h>
+#include <circuit_breaker.h>
 
 #include <string>
 #include <boost/asio.hpp>
@@ -11,10 +12,12 @@ namespace spectator {
 class UDSWriter final : public BaseWriter
 {
    public:
-    UDSWriter(const std::string& socketPath);
+    UDSWriter(const std::string& socketPath, const SocketOptions& options = {});
     ~UDSWriter() override;
     void Write(const std::string& message) override;
+    void WriteBatch(std::span<const std::string> messages) override;
     void Close() override;
+    void CloseAfterFork() override;
 
    private:
     std::string m_socketPath;
@@ -22,9 +25,13 @@ class UDSWriter final : public BaseWriter
     std::unique_ptr<boost::asio::local::datagram_protocol::socket> m_socket;
     boost::asio::local::datagram_protocol::endpoint m_endpoint;
     bool m_socketEstablished;
-    
-    bool CreateSocket();
-    bool TryToSend(const std::string& message);
+    SocketOptions m_options;
+    CircuitBreaker m_breaker;
+
+    // Each returns false on failure, with the reason in error for the circuit breaker to report
+    bool CreateSocket(std::string& error);
+    bool TryToSend(const std::string& message, std::string& error);
+    bool TryToSendBatch(std::span<const std::string> messages, std::string& error);
 };
 
 }  // namespace spectator
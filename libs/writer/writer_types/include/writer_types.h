@@ -1,10 +1,19 @@
 #pragma once
 
+#include "datagram_packer.h"
 #include "memory_writer.h"
 #include "udp_writer.h"
 #include "uds_writer.h"
 
+#ifdef __linux__
+#include "io_uring_writer.h"
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -38,6 +47,93 @@ struct DefaultLocations
     static constexpr auto UDS = "unix:///run/spectatord/spectatord.unix";
 };
 
+// What a producer does when the buffer has no room for its line
+enum class OverflowPolicy
+{
+    // Waits for the sending thread to make room
+    Block,
+    // Drops the line being written
+    DropNewest,
+    // Drops the oldest buffered lines to make room
+    DropOldest
+};
+
+// Returns the current time. The Writer reads time through this so that tests can control it.
+using WriterClock = std::function<std::chrono::steady_clock::time_point()>;
+
+// Tuning options for how the Writer batches and sends lines
+struct WriterOptions
+{
+    static constexpr std::chrono::milliseconds DefaultFlushInterval{1000};
+    static constexpr std::chrono::milliseconds DefaultShutdownTimeout{2000};
+    static constexpr size_t DefaultMaxDeferredPrefixes = 10000;
+
+    // Lines are sent in batches of about this many bytes. 0 sends every line as soon as it is written.
+    unsigned int bufferSize = 0;
+
+    // Each producer thread fills its own buffer, so threads never contend with each other while writing
+    bool threadLocalBuffers = false;
+
+    // How often the sending thread collects partially filled thread-local buffers
+    std::chrono::milliseconds flushInterval = DefaultFlushInterval;
+
+    // Shared buffer only. Meters enqueue their value in binary, and the sending thread formats the lines, so recording
+    // a value does no string work. The buffer size then counts about 16 bytes per value instead of the line length.
+    bool deferFormatting = false;
+
+    // Deferred formatting only. The sending thread keeps the prefix of at most this many meters, and the lines of any
+    // further meters are formatted by the thread recording the value, as without deferred formatting. Unset, a
+    // Registry uses its meter cache size, and a writer on its own DefaultMaxDeferredPrefixes.
+    std::optional<size_t> maxDeferredPrefixes;
+
+    // Buffered only. Counter, gauge and max gauge updates in a batch are coalesced into one line per meter, with the
+    // deltas summed, the last gauge value and the largest max gauge value. Other meters are sent sample by sample.
+    bool coalesce = false;
+
+    // Longest a line may wait in a shared buffer that is not full yet before it is sent. 0 waits for a full buffer.
+    std::chrono::milliseconds maxLinger{0};
+
+    // Buffered lines are packed into datagrams of at most this many bytes, without splitting lines. Use
+    // DatagramPacker::MtuUdpPayload to avoid IP fragmentation when sending UDP to another host.
+    size_t maxDatagramSize = DatagramPacker::MaxUdpPayload;
+
+    // Above 0, the UDP writer sends batches with generic segmentation offload, in segments of this many bytes
+    size_t udpSegmentSize = 0;
+
+    // Send UDP and Unix domain socket datagrams in batches through io_uring, where the kernel supports it
+    bool ioUring = false;
+
+    // What writers do when the buffer is full. Any policy but Block also makes the sockets non-blocking, so a full
+    // socket buffer drops the datagram instead of stalling the sending thread.
+    OverflowPolicy overflowPolicy = OverflowPolicy::Block;
+
+    // SO_SNDBUF for the UDP and Unix domain sockets in bytes. 0 keeps the system default.
+    int sendBufferSize = 0;
+
+    // How long shutting down the writer waits for buffered lines to be sent
+    std::chrono::milliseconds shutdownTimeout = DefaultShutdownTimeout;
+
+    // Empty uses std::chrono::steady_clock
+    WriterClock clock{};
+};
+
+// Datagrams handed to the transport, and lines (with their bytes, including newlines) dropped instead of sent
+struct WriterStats
+{
+    uint64_t sentDatagrams = 0;
+    uint64_t sentBytes = 0;
+    uint64_t droppedLines = 0;
+    uint64_t droppedBytes = 0;
+};
+
+// What a flush sent and dropped, including lines written by other threads while it ran
+struct FlushResult
+{
+    // Whether every line buffered when the flush started was handed to the transport in time
+    bool completed = false;
+    WriterStats stats{};
+};
+
 inline const std::map<std::string_view, std::pair<WriterType, std::string_view>> TypeToLocationMap = {
     {WriterTypes::Memory, {WriterType::Memory, DefaultLocations::NoLocation}},
     {WriterTypes::UDP, {WriterType::UDP, DefaultLocations::UDP}},
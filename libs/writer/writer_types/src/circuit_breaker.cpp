@@ -0,0 +1,98 @@
+#include <circuit_breaker.h>
+
+#include <logger.h>
+
+#include <algorithm>
+
+namespace spectator {
+
+CircuitBreaker::CircuitBreaker(std::string name, unsigned failureThreshold, std::chrono::milliseconds initialBackoff,
+                               std::chrono::milliseconds maxBackoff, Clock clock)
+    : m_name(std::move(name)),
+      m_failureThreshold(std::max(failureThreshold, 1u)),
+      m_initialBackoff(initialBackoff),
+      m_maxBackoff(std::max(maxBackoff, initialBackoff)),
+      m_clock(std::move(clock)),
+      m_backoff(initialBackoff)
+{
+}
+
+std::chrono::steady_clock::time_point CircuitBreaker::Now() const
+{
+    return m_clock ? m_clock() : std::chrono::steady_clock::now();
+}
+
+bool CircuitBreaker::AllowWrite()
+{
+    if (m_open.load(std::memory_order_relaxed) == false)
+    {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_open.load(std::memory_order_relaxed) == false)
+    {
+        return true;
+    }
+    if (m_probing || Now() < m_retryAt)
+    {
+        m_refused++;
+        return false;
+    }
+    // Only one write at a time probes the sidecar
+    m_probing = true;
+    return true;
+}
+
+void CircuitBreaker::RecordSuccess()
+{
+    if (m_open.load(std::memory_order_relaxed) == false && m_failures.load(std::memory_order_relaxed) == 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_failures.store(0, std::memory_order_relaxed);
+    if (m_open.load(std::memory_order_relaxed))
+    {
+        Logger::info("{}: Available again, {} writes were dropped while it was unavailable", m_name, m_refused);
+        m_open.store(false, std::memory_order_relaxed);
+        m_probing = false;
+        m_refused = 0;
+        m_backoff = m_initialBackoff;
+    }
+}
+
+void CircuitBreaker::RecordFailure(std::string_view reason)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_open.load(std::memory_order_relaxed))
+    {
+        if (m_probing)
+        {
+            m_probing = false;
+            m_backoff = std::min(m_backoff * 2, m_maxBackoff);
+            m_retryAt = Now() + m_backoff;
+            Logger::warn("{}: Still unavailable{}{}, {} writes dropped so far, retrying in {}ms", m_name,
+                         reason.empty() ? "" : " - ", reason, m_refused, m_backoff.count());
+        }
+        return;
+    }
+
+    const auto failures = m_failures.load(std::memory_order_relaxed) + 1;
+    m_failures.store(failures, std::memory_order_relaxed);
+    if (failures == 1 && reason.empty() == false)
+    {
+        Logger::error("{}: {}", m_name, reason);
+    }
+    if (failures >= m_failureThreshold)
+    {
+        m_open.store(true, std::memory_order_relaxed);
+        m_backoff = m_initialBackoff;
+        m_retryAt = Now() + m_backoff;
+        Logger::warn("{}: Unavailable after {} consecutive failures, dropping writes for {}ms", m_name, failures,
+                     m_backoff.count());
+    }
+}
+
+}  // namespace spectator
@@ -0,0 +1,55 @@
+#include <datagram_packer.h>
+
+#include <algorithm>
+
+namespace spectator {
+
+static constexpr auto NEW_LINE = '\n';
+
+DatagramPacker::DatagramPacker(size_t maxPayload) : m_maxPayload(maxPayload) {}
+
+std::string& DatagramPacker::DatagramFor(size_t size)
+{
+    if (m_count > 0 && m_datagrams[m_count - 1].size() + size <= m_maxPayload)
+    {
+        return m_datagrams[m_count - 1];
+    }
+
+    if (m_count == m_datagrams.size())
+    {
+        m_datagrams.emplace_back();
+        m_datagrams.back().reserve(m_maxPayload);
+    }
+    auto& datagram = m_datagrams[m_count++];
+    datagram.clear();
+    return datagram;
+}
+
+void DatagramPacker::Add(std::string_view line)
+{
+    auto& datagram = DatagramFor(line.size() + 1);
+    datagram.append(line);
+    datagram.push_back(NEW_LINE);
+}
+
+void DatagramPacker::AddLines(std::string_view lines)
+{
+    // Most blocks fit whole into the current datagram, so they are only split line by line when they do not
+    while (lines.empty() == false)
+    {
+        if (m_count > 0 && m_datagrams[m_count - 1].size() + lines.size() <= m_maxPayload)
+        {
+            m_datagrams[m_count - 1].append(lines);
+            return;
+        }
+
+        auto end = lines.find(NEW_LINE);
+        end = end == std::string_view::npos ? lines.size() : end;
+        Add(lines.substr(0, end));
+        lines.remove_prefix(std::min(end + 1, lines.size()));
+    }
+}
+
+void DatagramPacker::Clear() noexcept { m_count = 0; }
+
+}  // namespace spectator
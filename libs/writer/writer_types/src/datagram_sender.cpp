@@ -0,0 +1,148 @@
+#include <datagram_sender.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace spectator {
+
+bool IsDatagramError(const boost::system::error_code& ec) noexcept
+{
+    return ec.category() == boost::system::system_category() && (ec.value() == EMSGSIZE || ec.value() == ENOBUFS);
+}
+
+#ifdef __linux__
+
+// Messages submitted per sendmmsg call, small enough for the headers to live on the stack
+static constexpr size_t BATCH_SIZE = 64;
+
+size_t SendDatagrams(int fd, const void* destination, size_t destinationSize, std::span<const std::string> messages,
+                     boost::system::error_code& ec)
+{
+    ec.clear();
+    std::array<mmsghdr, BATCH_SIZE> headers{};
+    std::array<iovec, BATCH_SIZE> iovecs{};
+
+    size_t sent = 0;
+    while (sent < messages.size())
+    {
+        const auto count = std::min(BATCH_SIZE, messages.size() - sent);
+        for (size_t i = 0; i < count; i++)
+        {
+            const auto& message = messages[sent + i];
+            iovecs[i].iov_base = const_cast<char*>(message.data());
+            iovecs[i].iov_len = message.size();
+            headers[i] = mmsghdr{};
+            headers[i].msg_hdr.msg_name = const_cast<void*>(destination);
+            headers[i].msg_hdr.msg_namelen = static_cast<socklen_t>(destinationSize);
+            headers[i].msg_hdr.msg_iov = &iovecs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        const int result = ::sendmmsg(fd, headers.data(), static_cast<unsigned int>(count), 0);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ec.assign(errno, boost::system::system_category());
+            return sent;
+        }
+        // A partial result means the next message would have failed; the next call reports why, or sends it
+        sent += static_cast<size_t>(result);
+    }
+    return sent;
+}
+
+bool UdpSegmentationSupported(int fd, size_t segmentSize)
+{
+    // Setting the option proves the kernel knows it. It is reset right away because segmentation is requested per
+    // send, so that datagrams sent without it are never split.
+    int size = static_cast<int>(segmentSize);
+    if (::setsockopt(fd, SOL_UDP, UDP_SEGMENT, &size, sizeof(size)) != 0)
+    {
+        return false;
+    }
+    size = 0;
+    ::setsockopt(fd, SOL_UDP, UDP_SEGMENT, &size, sizeof(size));
+    return true;
+}
+
+bool SendSegmented(int fd, const void* destination, size_t destinationSize, std::string_view buffer,
+                   size_t segmentSize, boost::system::error_code& ec)
+{
+    ec.clear();
+    iovec iov{const_cast<char*>(buffer.data()), buffer.size()};
+    alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(uint16_t))> control{};
+
+    msghdr message{};
+    message.msg_name = const_cast<void*>(destination);
+    message.msg_namelen = static_cast<socklen_t>(destinationSize);
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data();
+    message.msg_controllen = control.size();
+
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_UDP;
+    header->cmsg_type = UDP_SEGMENT;
+    header->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    const auto size = static_cast<uint16_t>(segmentSize);
+    std::memcpy(CMSG_DATA(header), &size, sizeof(size));
+
+    while (::sendmsg(fd, &message, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            ec.assign(errno, boost::system::system_category());
+            return false;
+        }
+    }
+    return true;
+}
+
+#else
+
+size_t SendDatagrams(int fd, const void* destination, size_t destinationSize, std::span<const std::string> messages,
+                     boost::system::error_code& ec)
+{
+    ec.clear();
+    size_t sent = 0;
+    while (sent < messages.size())
+    {
+        const auto& message = messages[sent];
+        const auto result = ::sendto(fd, message.data(), message.size(), 0, static_cast<const sockaddr*>(destination),
+                                     static_cast<socklen_t>(destinationSize));
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ec.assign(errno, boost::system::system_category());
+            return sent;
+        }
+        sent++;
+    }
+    return sent;
+}
+
+bool UdpSegmentationSupported(int, size_t) { return false; }
+
+bool SendSegmented(int, const void*, size_t, std::string_view, size_t, boost::system::error_code& ec)
+{
+    ec = boost::system::errc::make_error_code(boost::system::errc::operation_not_supported);
+    return false;
+}
+
+#endif
+
+}  // namespace spectator
@@ -0,0 +1,498 @@
+#include <io_uring_writer.h>
+
+#include <datagram_sender.h>
+#include <logger.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+#include <string_view>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace spectator {
+
+namespace {
+
+int SetupSyscall(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int EnterSyscall(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int RegisterSyscall(int ringFd, unsigned opcode, const void* arg, unsigned count)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, ringFd, opcode, arg, count));
+}
+
+// The ring indexes are shared with the kernel, which reads what we release and publishes what we acquire
+unsigned LoadAcquire(unsigned* value) { return std::atomic_ref<unsigned>(*value).load(std::memory_order_acquire); }
+
+void StoreRelease(unsigned* value, unsigned newValue)
+{
+    std::atomic_ref<unsigned>(*value).store(newValue, std::memory_order_release);
+}
+
+// Asks the kernel which operations it knows. Kernels before 5.6 cannot be probed, and do not have IORING_OP_SEND either.
+bool SupportsOperations(int ringFd, std::initializer_list<uint8_t> opcodes)
+{
+    constexpr unsigned MAX_OPS = 256;
+    std::vector<char> storage(sizeof(io_uring_probe) + MAX_OPS * sizeof(io_uring_probe_op));
+    auto* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+    if (RegisterSyscall(ringFd, IORING_REGISTER_PROBE, probe, MAX_OPS) != 0)
+    {
+        return false;
+    }
+    return std::all_of(opcodes.begin(), opcodes.end(),
+                       [probe](uint8_t opcode)
+                       { return opcode <= probe->last_op && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) != 0; });
+}
+
+template <typename T>
+T* At(void* base, uint32_t offset)
+{
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+}  // namespace
+
+IoUringWriter::IoUringWriter(const std::string& host, int port, const SocketOptions& options)
+    : m_description(host + ":" + std::to_string(port)), m_options(options), m_breaker("IoUring Writer " + m_description)
+{
+    try
+    {
+        const boost::asio::ip::udp::endpoint endpoint(boost::asio::ip::address::from_string(host), port);
+        std::memcpy(&m_address, endpoint.data(), endpoint.size());
+        m_addressSize = static_cast<socklen_t>(endpoint.size());
+    }
+    catch (const boost::system::system_error& ex)
+    {
+        Logger::error("IoUring Writer: Invalid address {} - {}", m_description, ex.what());
+    }
+
+    if (false == SetupRing() || false == CreateSocket())
+    {
+        m_breaker.RecordFailure("Failed to create socket during construction - " + m_lastError);
+    }
+}
+
+IoUringWriter::IoUringWriter(const std::string& socketPath, const SocketOptions& options)
+    : m_description(socketPath), m_options(options), m_breaker("IoUring Writer " + m_description)
+{
+    const boost::asio::local::datagram_protocol::endpoint endpoint(socketPath);
+    std::memcpy(&m_address, endpoint.data(), endpoint.size());
+    m_addressSize = static_cast<socklen_t>(endpoint.size());
+
+    if (false == SetupRing() || false == CreateSocket())
+    {
+        m_breaker.RecordFailure("Failed to create socket during construction - " + m_lastError);
+    }
+}
+
+IoUringWriter::~IoUringWriter()
+{
+    Close();
+    TearDownRing();
+}
+
+bool IoUringWriter::IsSupported()
+{
+    static const bool supported = []
+    {
+        io_uring_params params{};
+        const int ringFd = SetupSyscall(1, &params);
+        if (ringFd < 0)
+        {
+            return false;
+        }
+        // Plain sends are the fallback when the buffers cannot be registered, so both must work
+        const bool supported = SupportsOperations(ringFd, {IORING_OP_WRITE_FIXED, IORING_OP_SEND});
+        ::close(ringFd);
+        return supported;
+    }();
+    return supported;
+}
+
+bool IoUringWriter::SetupRing()
+{
+    io_uring_params params{};
+    m_ringFd = SetupSyscall(QUEUE_DEPTH, &params);
+    if (m_ringFd < 0)
+    {
+        m_lastError = std::strerror(errno);
+        Logger::error("IoUring Writer: Failed to set up ring - {}", m_lastError);
+        return false;
+    }
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap)
+    {
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+    }
+
+    m_sqRing = ::mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd,
+                      IORING_OFF_SQ_RING);
+    m_cqRing = singleMmap ? m_sqRing
+                          : ::mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd,
+                                   IORING_OFF_CQ_RING);
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd,
+                        IORING_OFF_SQES);
+    if (m_sqRing == MAP_FAILED || m_cqRing == MAP_FAILED || sqes == MAP_FAILED)
+    {
+        m_lastError = std::strerror(errno);
+        Logger::error("IoUring Writer: Failed to map ring - {}", m_lastError);
+        m_sqRing = m_sqRing == MAP_FAILED ? nullptr : m_sqRing;
+        m_cqRing = m_cqRing == MAP_FAILED ? nullptr : m_cqRing;
+        m_sqes = sqes == MAP_FAILED ? nullptr : static_cast<io_uring_sqe*>(sqes);
+        TearDownRing();
+        return false;
+    }
+    m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+    m_sqHead = At<unsigned>(m_sqRing, params.sq_off.head);
+    m_sqTail = At<unsigned>(m_sqRing, params.sq_off.tail);
+    m_sqArray = At<unsigned>(m_sqRing, params.sq_off.array);
+    m_sqMask = *At<unsigned>(m_sqRing, params.sq_off.ring_mask);
+    m_sqEntries = params.sq_entries;
+    m_cqHead = At<unsigned>(m_cqRing, params.cq_off.head);
+    m_cqTail = At<unsigned>(m_cqRing, params.cq_off.tail);
+    m_cqMask = *At<unsigned>(m_cqRing, params.cq_off.ring_mask);
+    m_cqes = At<io_uring_cqe>(m_cqRing, params.cq_off.cqes);
+
+    m_buffers = std::make_unique<char[]>(NUM_BUFFERS * BUFFER_SIZE);
+    iovec iovecs[NUM_BUFFERS];
+    for (size_t i = 0; i < NUM_BUFFERS; i++)
+    {
+        iovecs[i].iov_base = m_buffers.get() + i * BUFFER_SIZE;
+        iovecs[i].iov_len = BUFFER_SIZE;
+        m_freeBuffers.push_back(static_cast<uint16_t>(i));
+    }
+    m_fixedBuffers = RegisterSyscall(m_ringFd, IORING_REGISTER_BUFFERS, iovecs, NUM_BUFFERS) == 0;
+    if (false == m_fixedBuffers)
+    {
+        Logger::warn("IoUring Writer: Failed to register buffers - {}, using plain sends", std::strerror(errno));
+    }
+    return true;
+}
+
+void IoUringWriter::TearDownRing()
+{
+    if (m_sqes != nullptr)
+    {
+        ::munmap(m_sqes, m_sqesSize);
+        m_sqes = nullptr;
+    }
+    if (m_cqRing != nullptr && m_cqRing != m_sqRing)
+    {
+        ::munmap(m_cqRing, m_cqRingSize);
+    }
+    m_cqRing = nullptr;
+    if (m_sqRing != nullptr)
+    {
+        ::munmap(m_sqRing, m_sqRingSize);
+        m_sqRing = nullptr;
+    }
+    if (m_ringFd >= 0)
+    {
+        ::close(m_ringFd);
+        m_ringFd = -1;
+    }
+}
+
+bool IoUringWriter::CreateSocket()
+{
+    if (m_socket >= 0)
+    {
+        DrainAndCloseSocket();
+    }
+    if (m_ringFd < 0 || m_addressSize == 0)
+    {
+        return false;
+    }
+
+    // Sends are plain writes to the socket, so it is connected to the destination
+    m_socket = ::socket(m_address.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (m_socket < 0)
+    {
+        m_lastError = std::strerror(errno);
+        Logger::debug("IoUring Writer: Failed to create socket - {}", m_lastError);
+        return false;
+    }
+    if (m_options.sendBufferSize > 0 &&
+        ::setsockopt(m_socket, SOL_SOCKET, SO_SNDBUF, &m_options.sendBufferSize, sizeof(m_options.sendBufferSize)) != 0)
+    {
+        Logger::warn("IoUring Writer: Failed to set send buffer size to {} - {}", m_options.sendBufferSize,
+                     std::strerror(errno));
+    }
+    if (::connect(m_socket, reinterpret_cast<const sockaddr*>(&m_address), m_addressSize) != 0)
+    {
+        m_lastError = std::strerror(errno);
+        Logger::debug("IoUring Writer: Failed to connect socket to {} - {}", m_description, m_lastError);
+        CloseSocket();
+        return false;
+    }
+
+    m_socketEstablished = true;
+    Logger::info("IoUring Writer: Socket created for {}", m_description);
+    return true;
+}
+
+void IoUringWriter::CloseSocket()
+{
+    if (m_socket >= 0)
+    {
+        ::close(m_socket);
+        m_socket = -1;
+    }
+}
+
+bool IoUringWriter::Enter(unsigned toSubmit, unsigned minComplete)
+{
+    const unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    while (toSubmit > 0 || minComplete > 0)
+    {
+        const int result = EnterSyscall(m_ringFd, toSubmit, minComplete, flags);
+        if (result >= 0)
+        {
+            // Submitted entries are consumed in order, so anything not taken yet is submitted on the next pass
+            toSubmit -= std::min(toSubmit, static_cast<unsigned>(result));
+            minComplete = 0;
+            continue;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EBUSY)
+        {
+            // The completion queue is full: free some entries and try again
+            ReapCompletions();
+            continue;
+        }
+        m_lastError = std::strerror(errno);
+        Logger::debug("IoUring Writer: Failed to submit sends - {}", m_lastError);
+        return false;
+    }
+    return true;
+}
+
+void IoUringWriter::ReapCompletions()
+{
+    unsigned head = *m_cqHead;
+    const unsigned tail = LoadAcquire(m_cqTail);
+    for (; head != tail; head++)
+    {
+        const io_uring_cqe& cqe = m_cqes[head & m_cqMask];
+        const auto index = static_cast<uint16_t>(cqe.user_data);
+        const std::string_view message(m_buffers.get() + index * BUFFER_SIZE, m_messageSizes[index]);
+        const boost::system::error_code ec(-cqe.res, boost::system::system_category());
+        if (cqe.res == -ECANCELED || cqe.res == -EINTR)
+        {
+            // The thread that submitted it exited, or a send before it in the chain failed. Either way the send
+            // itself was never tried, so it is tried again on its own.
+            m_retries.push_back(index);
+            continue;
+        }
+        if (cqe.res >= 0)
+        {
+            RecordSent(message);
+        }
+        else if (cqe.res == -EAGAIN || IsDatagramError(ec))
+        {
+            // The socket buffer is full, or the datagram too long for it: the line is dropped, but the socket is fine
+            RecordDrop(message);
+        }
+        else
+        {
+            m_lastError = ec.message();
+            Logger::debug("IoUring Writer: Failed to send message to {} - {}", m_description, m_lastError);
+            RecordDrop(message);
+            m_socketEstablished = false;
+        }
+        m_freeBuffers.push_back(index);
+        m_inFlight--;
+    }
+    StoreRelease(m_cqHead, head);
+}
+
+io_uring_sqe* IoUringWriter::Queue(uint16_t index, io_uring_sqe* previous)
+{
+    // The queue has room for every buffer, so there is always a free entry here
+    const unsigned tail = *m_sqTail;
+    io_uring_sqe* sqe = &m_sqes[tail & m_sqMask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = m_fixedBuffers ? IORING_OP_WRITE_FIXED : IORING_OP_SEND;
+    sqe->fd = m_socket;
+    sqe->addr = reinterpret_cast<uint64_t>(m_buffers.get() + index * BUFFER_SIZE);
+    sqe->len = m_messageSizes[index];
+    if (m_fixedBuffers)
+    {
+        sqe->buf_index = index;
+    }
+    if (m_options.nonBlocking)
+    {
+        // io_uring waits for room in the socket buffer even on a non-blocking socket, unless the send says otherwise
+        if (m_fixedBuffers)
+        {
+            sqe->rw_flags = RWF_NOWAIT;
+        }
+        else
+        {
+            sqe->msg_flags = MSG_DONTWAIT;
+        }
+    }
+    sqe->user_data = index;
+    m_sqArray[tail & m_sqMask] = tail & m_sqMask;
+    if (previous != nullptr)
+    {
+        previous->flags |= IOSQE_IO_LINK;
+    }
+    StoreRelease(m_sqTail, tail + 1);
+    return sqe;
+}
+
+unsigned IoUringWriter::QueueRetries()
+{
+    for (const auto index : m_retries)
+    {
+        Queue(index, nullptr);
+    }
+    const auto queued = static_cast<unsigned>(m_retries.size());
+    m_retries.clear();
+    return queued;
+}
+
+bool IoUringWriter::Submit(std::span<const std::string> messages)
+{
+    // Frees the buffers of the sends that completed since the last write
+    ReapCompletions();
+    unsigned queued = QueueRetries();
+    io_uring_sqe* previous = nullptr;
+    for (size_t i = 0; i < messages.size(); i++)
+    {
+        const auto& message = messages[i];
+        if (message.size() > BUFFER_SIZE)
+        {
+            Logger::debug("IoUring Writer: Dropping message of {} bytes, larger than a datagram", message.size());
+            RecordDrop(message);
+            continue;
+        }
+
+        while (m_freeBuffers.empty())
+        {
+            // Every buffer is in flight: submit what is queued and wait for a send to complete
+            if (false == Enter(queued, 1))
+            {
+                RecordDrops(messages.subspan(i));
+                return false;
+            }
+            ReapCompletions();
+            queued = QueueRetries();
+            previous = nullptr;
+        }
+
+        const uint16_t index = m_freeBuffers.back();
+        m_freeBuffers.pop_back();
+        std::memcpy(m_buffers.get() + index * BUFFER_SIZE, message.data(), message.size());
+        m_messageSizes[index] = static_cast<uint32_t>(message.size());
+        previous = Queue(index, previous);
+        queued++;
+        m_inFlight++;
+    }
+
+    // Sends that can go out right away complete within this call, so they are counted before the write returns.
+    // So do the sends cancelled because one before them in the chain failed, which are tried again on their own.
+    do
+    {
+        if (false == Enter(queued, 0))
+        {
+            return false;
+        }
+        ReapCompletions();
+        queued = QueueRetries();
+    } while (queued > 0);
+    return true;
+}
+
+void IoUringWriter::Write(const std::string& message) { WriteBatch(std::span<const std::string>(&message, 1)); }
+
+void IoUringWriter::WriteBatch(std::span<const std::string> messages)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (false == m_breaker.AllowWrite())
+    {
+        RecordDrops(messages);
+        return;
+    }
+
+    if (false == this->m_socketEstablished && false == this->CreateSocket())
+    {
+        RecordDrops(messages);
+        m_breaker.RecordFailure("Failed to write batch, socket not established - " + m_lastError);
+        return;
+    }
+
+    if (false == this->Submit(messages))
+    {
+        DrainAndCloseSocket();
+        m_breaker.RecordFailure("Failed to submit batch of " + std::to_string(messages.size()) + " datagrams - " +
+                                m_lastError);
+        return;
+    }
+
+    // A failed send marked the socket as broken, so that the next write opens it again
+    if (false == m_socketEstablished)
+    {
+        m_breaker.RecordFailure("Failed to send message - " + m_lastError);
+        return;
+    }
+    m_breaker.RecordSuccess();
+}
+
+void IoUringWriter::Close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    DrainAndCloseSocket();
+}
+
+void IoUringWriter::CloseAfterFork()
+{
+    // A thread of the parent may have been writing when it forked. Its lock is replaced rather than taken, and its
+    // sends complete in the parent's ring.
+    new (&m_mutex) std::mutex();
+    m_inFlight = 0;
+    m_retries.clear();
+    m_socketEstablished = false;
+    CloseSocket();
+    TearDownRing();
+}
+
+void IoUringWriter::DrainAndCloseSocket()
+{
+    // The kernel may still be using the socket and the buffers of the sends in flight. Cancelled sends are sent
+    // again from this thread, so that lines written by threads that have exited since are not lost.
+    while (m_inFlight > 0 && Enter(QueueRetries(), 1))
+    {
+        ReapCompletions();
+    }
+    this->m_socketEstablished = false;
+    CloseSocket();
+}
+
+}  // namespace spectator
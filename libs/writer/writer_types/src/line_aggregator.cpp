@@ -0,0 +1,86 @@
+#include <line_aggregator.h>
+
+#include <util.h>
+
+#include <algorithm>
+#include <charconv>
+
+namespace spectator {
+
+bool LineAggregator::Add(std::string_view line)
+{
+    const auto valueStart = line.rfind(':');
+    if (valueStart == std::string_view::npos)
+    {
+        return false;
+    }
+
+    const auto value = line.substr(valueStart + 1);
+    double parsed = 0;
+    const auto result = std::from_chars(value.data(), value.data() + value.size(), parsed);
+    if (result.ec != std::errc() || result.ptr != value.data() + value.size())
+    {
+        return false;
+    }
+    return Add(line.substr(0, valueStart + 1), parsed);
+}
+
+bool LineAggregator::Add(std::string_view prefix, double value)
+{
+    // The type symbol is the first field, and gauges may carry a TTL in it, e.g. "g,120"
+    const auto symbol = prefix.substr(0, prefix.find_first_of(",:"));
+    Kind kind;
+    if (symbol == "c")
+    {
+        kind = Kind::Sum;
+    }
+    else if (symbol == "g")
+    {
+        kind = Kind::Last;
+    }
+    else if (symbol == "m")
+    {
+        kind = Kind::Max;
+    }
+    else
+    {
+        return false;
+    }
+
+    const auto it = m_index.find(prefix);
+    if (it == m_index.end())
+    {
+        m_index.emplace(prefix, m_entries.size());
+        m_entries.push_back({std::string(prefix), kind, value});
+        return true;
+    }
+
+    auto& entry = m_entries[it->second];
+    switch (kind)
+    {
+        case Kind::Sum:
+            entry.value += value;
+            break;
+        case Kind::Last:
+            entry.value = value;
+            break;
+        case Kind::Max:
+            entry.value = std::max(entry.value, value);
+            break;
+    }
+    return true;
+}
+
+void LineAggregator::Flush(DatagramPacker& packer)
+{
+    for (const auto& entry : m_entries)
+    {
+        m_line.assign(entry.prefix);
+        AppendValue(m_line, entry.value);
+        packer.Add(m_line);
+    }
+    m_entries.clear();
+    m_index.clear();
+}
+
+}  // namespace spectator
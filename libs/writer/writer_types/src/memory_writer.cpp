@@ -7,6 +7,7 @@ namespace spectator {
 void MemoryWriter::Write(const std::string& message)
 {
     this->m_messages.push_back(message);
+    RecordSent(message);
 }
 
 void MemoryWriter::Close()
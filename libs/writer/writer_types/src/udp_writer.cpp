@@ -1,25 +1,33 @@
 #include <udp_writer.h>
 
+#include <datagram_sender.h>
 #include <logger.h>
 
+#include <algorithm>
+
 namespace spectator {
 
-UDPWriter::UDPWriter(const std::string& host, int port) : 
+UDPWriter::UDPWriter(const std::string& host, int port, const SocketOptions& options) : 
     m_host(host), 
     m_port(port),
     m_io_context(std::make_unique<boost::asio::io_context>()),
     m_socket(nullptr), 
-    m_socketEstablished(false)
+    m_socketEstablished(false),
+    m_options(options),
+    m_breaker("UDPWriter " + host + ":" + std::to_string(port)),
+    m_segmentSize(std::min(options.udpSegmentSize, DatagramPacker::MaxUdpPayload)),
+    m_segmentPacker(m_segmentSize)
 {
-    if (false == CreateSocket())
+    std::string error;
+    if (false == CreateSocket(error))
     {
-        Logger::error("UDPWriter: Failed to create socket for {}:{} during construction", m_host, m_port);
+        m_breaker.RecordFailure("Failed to create socket during construction - " + error);
     }
 }
 
 UDPWriter::~UDPWriter() { Close(); }
 
-bool UDPWriter::CreateSocket() try
+bool UDPWriter::CreateSocket(std::string& error) try
 {
     if (m_socketEstablished)
     {
@@ -31,55 +39,248 @@ bool UDPWriter::CreateSocket() try
     m_socket->open(boost::asio::ip::udp::v4(), ec);
     if (ec)
     {
-        Logger::error("UDPWriter: Failed to create socket - {}", ec.message());
+        error = ec.message();
+        Logger::debug("UDPWriter: Failed to create socket - {}", error);
         return false;
     }
     
+    if (m_options.sendBufferSize > 0)
+    {
+        m_socket->set_option(boost::asio::socket_base::send_buffer_size(m_options.sendBufferSize), ec);
+        if (ec)
+        {
+            Logger::warn("UDPWriter: Failed to set send buffer size to {} - {}", m_options.sendBufferSize, ec.message());
+        }
+    }
+
+    if (m_options.nonBlocking)
+    {
+        m_socket->non_blocking(true, ec);
+        if (ec)
+        {
+            Logger::warn("UDPWriter: Failed to make socket non-blocking - {}", ec.message());
+        }
+    }
+
+    if (m_segmentSize > 0 && false == UdpSegmentationSupported(m_socket->native_handle(), m_segmentSize))
+    {
+        Logger::warn("UDPWriter: UDP segmentation offload is not supported, sending plain datagrams");
+        m_segmentSize = 0;
+    }
+
+    // Connecting once saves the route lookup on every send. It also reports a refused port, through the error of a
+    // later send, which closes the socket and reconnects on the next write.
     m_endpoint = boost::asio::ip::udp::endpoint(boost::asio::ip::address::from_string(m_host), m_port);
+    m_socket->connect(m_endpoint, ec);
+    if (ec)
+    {
+        error = ec.message();
+        Logger::debug("UDPWriter: Failed to connect socket to {}:{} - {}", m_host, m_port, error);
+        return false;
+    }
     m_socketEstablished = true;
     Logger::info("UDPWriter: Socket created for {}:{}", m_host, m_port);
     return true;
 }
 catch (const boost::system::system_error& ex)
 {
-    Logger::error("UDP Writer: Boost exception: {}", ex.what());
+    error = ex.what();
+    Logger::debug("UDP Writer: Boost exception: {}", error);
     return false;
 }
 
-bool UDPWriter::TryToSend(const std::string& message) try
+bool UDPWriter::TryToSend(const std::string& message, std::string& error) try
 {
     boost::system::error_code ec;
     for (int i = 0; i < 3; i++)
     {
-        size_t sent = m_socket->send_to(boost::asio::buffer(message.data(), message.size()), m_endpoint, 0, ec);
+        size_t sent = m_socket->send(boost::asio::buffer(message.data(), message.size()), 0, ec);
+        if (ec == boost::asio::error::would_block || IsDatagramError(ec))
+        {
+            // The socket buffer is full, or the line too long for it: the line is dropped, but the socket is fine
+            RecordDrop(message);
+            return true;
+        }
         if (ec || sent < message.size())
-        {   
-            Logger::error("UDP Writer: Failed to send message - {}, sent {} bytes out of {}", ec.message(), sent, message.size());
+        {
+            error = ec.message();
+            Logger::debug("UDP Writer: Failed to send message - {}, sent {} bytes out of {}", error, sent,
+                          message.size());
             continue;
         }
+        RecordSent(message);
         return true;
     }
     return false;
 }
 catch (const boost::system::system_error& ex)
 {
-    Logger::error("UDP Writer: Boost exception: {}", ex.what());
+    error = ex.what();
+    Logger::debug("UDP Writer: Boost exception: {}", error);
     return false;
 }
 
+bool UDPWriter::TryToSendBatch(std::span<const std::string> messages, std::string& error)
+{
+    boost::system::error_code ec;
+    size_t sent = 0;
+    int failures = 0;
+    while (failures < 3 && sent < messages.size())
+    {
+        const size_t count = SendDatagrams(m_socket->native_handle(), nullptr, 0, messages.subspan(sent), ec);
+        RecordSent(messages.subspan(sent, count));
+        sent += count;
+        if (ec == boost::asio::error::would_block)
+        {
+            // The socket buffer is full, and would be for the rest of the batch too
+            RecordDrops(messages.subspan(sent));
+            return true;
+        }
+        if (IsDatagramError(ec))
+        {
+            // Only this datagram is at fault, e.g. a line longer than the socket accepts, so the rest still goes out
+            Logger::debug("UDP Writer: Dropped a datagram of {} bytes - {}", messages[sent].size(), ec.message());
+            RecordDrop(messages[sent]);
+            sent++;
+            continue;
+        }
+        if (ec)
+        {
+            failures++;
+            error = ec.message();
+            Logger::debug("UDP Writer: Failed to send batch - {}, sent {} datagrams out of {}", error, sent,
+                          messages.size());
+        }
+    }
+    if (sent < messages.size())
+    {
+        RecordDrops(messages.subspan(sent));
+        return false;
+    }
+    return true;
+}
+
+bool UDPWriter::TryToSendSegmented(std::span<const std::string> messages, std::string& error)
+{
+    m_segmentPacker.Clear();
+    for (const auto& message : messages)
+    {
+        m_segmentPacker.AddLines(message);
+    }
+
+    const auto segments = m_segmentPacker.Datagrams();
+    size_t next = 0;
+    while (next < segments.size())
+    {
+        // A line longer than a segment cannot be aligned, so it goes out as a datagram of its own
+        if (segments[next].size() > m_segmentSize)
+        {
+            if (false == TryToSendBatch(segments.subspan(next, 1), error))
+            {
+                return false;
+            }
+            next++;
+            continue;
+        }
+
+        // Every segment but the last is padded to the full segment size, which is where the kernel splits. Together
+        // the segments must still fit into the largest UDP payload.
+        const size_t first = next;
+        const size_t maxSegments = std::min(MAX_UDP_SEGMENTS, DatagramPacker::MaxUdpPayload / m_segmentSize);
+        m_segmentBuffer.clear();
+        while (next < segments.size() && next - first < maxSegments && segments[next].size() <= m_segmentSize)
+        {
+            m_segmentBuffer.resize((next - first) * m_segmentSize, '\n');
+            m_segmentBuffer.append(segments[next]);
+            next++;
+        }
+
+        boost::system::error_code ec;
+        if (SendSegmented(m_socket->native_handle(), nullptr, 0, m_segmentBuffer, m_segmentSize, ec))
+        {
+            // One datagram per segment, counted without the padding
+            RecordSent(segments.subspan(first, next - first));
+            continue;
+        }
+        if (ec == boost::asio::error::would_block)
+        {
+            // The socket buffer is full, which says nothing about segmentation support
+            RecordDrops(segments.subspan(first, next - first));
+            continue;
+        }
+
+        // The option can be accepted but still fail on send, e.g. for devices without checksum offload
+        Logger::warn("UDPWriter: UDP segmentation offload failed - {}, sending plain datagrams", ec.message());
+        m_segmentSize = 0;
+        return TryToSendBatch(segments.subspan(first), error);
+    }
+    return true;
+}
+
 void UDPWriter::Write(const std::string& message)
 {
-    if (false == this->m_socketEstablished && false == this->CreateSocket())
+    // While the sidecar is unavailable, writes are dropped without touching the socket
+    if (false == m_breaker.AllowWrite())
+    {
+        RecordDrop(message);
+        return;
+    }
+
+    std::string error;
+    if (false == this->m_socketEstablished && false == this->CreateSocket(error))
     {
-        Logger::error("UDPWriter: Failed to write message, socket not established {}:{}", m_host, m_port);
+        RecordDrop(message);
+        m_breaker.RecordFailure("Failed to write message, socket not established - " + error);
         return;
     }
 
-    if (TryToSend(message) == false)
+    if (TryToSend(message, error) == false)
     {
-        Logger::error("UDP Writer: Failed to send message: {}", message);
+        RecordDrop(message);
         this->Close();
+        m_breaker.RecordFailure("Failed to send message of " + std::to_string(message.size()) + " bytes - " + error);
+        return;
+    }
+    m_breaker.RecordSuccess();
+}
+
+void UDPWriter::WriteBatch(std::span<const std::string> messages)
+{
+    if (false == m_breaker.AllowWrite())
+    {
+        RecordDrops(messages);
+        return;
+    }
+
+    std::string error;
+    if (false == this->m_socketEstablished && false == this->CreateSocket(error))
+    {
+        RecordDrops(messages);
+        m_breaker.RecordFailure("Failed to write batch, socket not established - " + error);
+        return;
     }
+
+    const bool sent = m_segmentSize > 0 ? this->TryToSendSegmented(messages, error)
+                                          : this->TryToSendBatch(messages, error);
+    if (false == sent)
+    {
+        this->Close();
+        m_breaker.RecordFailure("Failed to send batch of " + std::to_string(messages.size()) + " datagrams - " + error);
+        return;
+    }
+    m_breaker.RecordSuccess();
+}
+
+void UDPWriter::CloseAfterFork() try
+{
+    // The io_context's epoll instance is shared with the parent too, so the child gets its own before the socket is
+    // closed and deregistered
+    m_io_context->notify_fork(boost::asio::execution_context::fork_child);
+    Close();
+}
+catch (const boost::system::system_error& ex)
+{
+    Logger::error("UDP Writer: Boost exception: {}", ex.what());
 }
 
 void UDPWriter::Close() try
@@ -1,24 +1,28 @@
 #include <uds_writer.h>
 
+#include <datagram_sender.h>
 #include <logger.h>
 
 namespace spectator {
 
-UDSWriter::UDSWriter(const std::string& socketPath)
+UDSWriter::UDSWriter(const std::string& socketPath, const SocketOptions& options)
     : m_socketPath(socketPath),
       m_ioContext(std::make_unique<boost::asio::io_context>()),
       m_socket(nullptr),
-      m_socketEstablished(false)
+      m_socketEstablished(false),
+      m_options(options),
+      m_breaker("UDS Writer " + socketPath)
 {
-    if (false == CreateSocket())
+    std::string error;
+    if (false == CreateSocket(error))
     {
-        Logger::error("UDS Writer: Failed to create socket for {} during construction", m_socketPath);
+        m_breaker.RecordFailure("Failed to create socket during construction - " + error);
     }
 }
 
 UDSWriter::~UDSWriter() { Close(); }
 
-bool UDSWriter::CreateSocket() try
+bool UDSWriter::CreateSocket(std::string& error) try
 {
     if (m_socketEstablished)
     {
@@ -30,55 +34,188 @@ bool UDSWriter::CreateSocket() try
     m_socket->open(boost::asio::local::datagram_protocol(), ec);
     if (ec)
     {
-        Logger::error("UDS Writer: Failed to create socket - {}", ec.message());
+        error = ec.message();
+        Logger::debug("UDS Writer: Failed to create socket - {}", error);
         return false;
     }
 
+    if (m_options.sendBufferSize > 0)
+    {
+        m_socket->set_option(boost::asio::socket_base::send_buffer_size(m_options.sendBufferSize), ec);
+        if (ec)
+        {
+            Logger::warn("UDS Writer: Failed to set send buffer size to {} - {}", m_options.sendBufferSize, ec.message());
+        }
+    }
+
+    if (m_options.nonBlocking)
+    {
+        m_socket->non_blocking(true, ec);
+        if (ec)
+        {
+            Logger::warn("UDS Writer: Failed to make socket non-blocking - {}", ec.message());
+        }
+    }
+
+    // Connecting once saves the path lookup on every send. A missing socket file or a refused connection fails
+    // here, and the next write tries again.
     m_endpoint = boost::asio::local::datagram_protocol::endpoint(m_socketPath);
+    m_socket->connect(m_endpoint, ec);
+    if (ec)
+    {
+        error = ec.message();
+        Logger::debug("UDS Writer: Failed to connect socket to {} - {}", m_socketPath, error);
+        return false;
+    }
     m_socketEstablished = true;
     Logger::info("UDS Writer: Socket created for {}", m_socketPath);
     return true;
 }
 catch (const boost::system::system_error& ex)
 {
-    Logger::error("UDS Writer: Boost exception: {}", ex.what());
+    error = ex.what();
+    Logger::debug("UDS Writer: Boost exception: {}", error);
     return false;
 }
 
-bool UDSWriter::TryToSend(const std::string& message) try
+bool UDSWriter::TryToSend(const std::string& message, std::string& error) try
 {
     boost::system::error_code ec;
     for (int i = 0; i < 3; i++)
     {
-        size_t sent = m_socket->send_to(boost::asio::buffer(message), m_endpoint, 0, ec);
+        size_t sent = m_socket->send(boost::asio::buffer(message), 0, ec);
+        if (ec == boost::asio::error::would_block || IsDatagramError(ec))
+        {
+            // The socket buffer is full, or the line too long for it: the line is dropped, but the socket is fine
+            RecordDrop(message);
+            return true;
+        }
         if (ec || sent < message.size())
-        {   
-            Logger::error("UDS Writer: Failed to send message - {}, sent {} bytes out of {}", ec.message(), sent, message.size());
+        {
+            error = ec.message();
+            Logger::debug("UDS Writer: Failed to send message - {}, sent {} bytes out of {}", error, sent,
+                          message.size());
+            if (ec == boost::asio::error::connection_refused || ec == boost::asio::error::not_connected)
+            {
+                // The server went away, so only reconnecting can help
+                return false;
+            }
             continue;
         }
+        RecordSent(message);
         return true;
     }
     return false;
 }
 catch (const boost::system::system_error& ex)
 {
-    Logger::error("UDS Writer: Boost exception: {}", ex.what());
+    error = ex.what();
+    Logger::debug("UDS Writer: Boost exception: {}", error);
     return false;
 }
 
+bool UDSWriter::TryToSendBatch(std::span<const std::string> messages, std::string& error)
+{
+    boost::system::error_code ec;
+    size_t sent = 0;
+    int failures = 0;
+    while (failures < 3 && sent < messages.size())
+    {
+        const size_t count = SendDatagrams(m_socket->native_handle(), nullptr, 0, messages.subspan(sent), ec);
+        RecordSent(messages.subspan(sent, count));
+        sent += count;
+        if (ec == boost::asio::error::would_block)
+        {
+            // The socket buffer is full, and would be for the rest of the batch too
+            RecordDrops(messages.subspan(sent));
+            return true;
+        }
+        if (IsDatagramError(ec))
+        {
+            // Only this datagram is at fault, e.g. a line longer than the socket accepts, so the rest still goes out
+            Logger::debug("UDS Writer: Dropped a datagram of {} bytes - {}", messages[sent].size(), ec.message());
+            RecordDrop(messages[sent]);
+            sent++;
+            continue;
+        }
+        if (ec)
+        {
+            failures++;
+            error = ec.message();
+            Logger::debug("UDS Writer: Failed to send batch - {}, sent {} datagrams out of {}", error, sent,
+                          messages.size());
+        }
+    }
+    if (sent < messages.size())
+    {
+        RecordDrops(messages.subspan(sent));
+        return false;
+    }
+    return true;
+}
+
 void UDSWriter::Write(const std::string& message)
 {
-    if (false == this->m_socketEstablished && false == this->CreateSocket())
+    // While the sidecar is unavailable, writes are dropped without touching the socket
+    if (false == m_breaker.AllowWrite())
     {
-        Logger::error("UDS Writer: Failed to write message, socket not established {}", m_socketPath);
+        RecordDrop(message);
         return;
     }
 
-    if (false == this->TryToSend(message))
+    std::string error;
+    if (false == this->m_socketEstablished && false == this->CreateSocket(error))
     {
-        Logger::error("UDS Writer: Failed to send message: {}", message);
+        RecordDrop(message);
+        m_breaker.RecordFailure("Failed to write message, socket not established - " + error);
+        return;
+    }
+
+    if (false == this->TryToSend(message, error))
+    {
+        RecordDrop(message);
         this->Close();
+        m_breaker.RecordFailure("Failed to send message of " + std::to_string(message.size()) + " bytes - " + error);
+        return;
+    }
+    m_breaker.RecordSuccess();
+}
+
+void UDSWriter::WriteBatch(std::span<const std::string> messages)
+{
+    if (false == m_breaker.AllowWrite())
+    {
+        RecordDrops(messages);
+        return;
     }
+
+    std::string error;
+    if (false == this->m_socketEstablished && false == this->CreateSocket(error))
+    {
+        RecordDrops(messages);
+        m_breaker.RecordFailure("Failed to write batch, socket not established - " + error);
+        return;
+    }
+
+    if (false == this->TryToSendBatch(messages, error))
+    {
+        this->Close();
+        m_breaker.RecordFailure("Failed to send batch of " + std::to_string(messages.size()) + " datagrams - " + error);
+        return;
+    }
+    m_breaker.RecordSuccess();
+}
+
+void UDSWriter::CloseAfterFork() try
+{
+    // The io_context's epoll instance is shared with the parent too, so the child gets its own before the socket is
+    // closed and deregistered
+    m_ioContext->notify_fork(boost::asio::execution_context::fork_child);
+    Close();
+}
+catch (const boost::system::system_error& ex)
+{
+    Logger::error("UDS Writer: Boost exception: {}", ex.what());
 }
 
 void UDSWriter::Close() try
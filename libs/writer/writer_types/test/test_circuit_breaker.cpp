@@ -0,0 +1,92 @@
+#include <circuit_breaker.h>
+#include <uds_writer.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+
+using namespace spectator;
+using namespace std::chrono_literals;
+
+// A breaker with a threshold of 3 and a backoff from 100ms to 400ms, on a clock that only the test moves
+class CircuitBreakerTest : public testing::Test
+{
+   protected:
+    CircuitBreaker m_breaker{"test", 3, 100ms, 400ms,
+                             [this] { return std::chrono::steady_clock::time_point(m_now); }};
+    std::chrono::milliseconds m_now{0};
+};
+
+TEST_F(CircuitBreakerTest, OpensAfterConsecutiveFailures)
+{
+    m_breaker.RecordFailure();
+    m_breaker.RecordFailure();
+    EXPECT_FALSE(m_breaker.IsOpen());
+    EXPECT_TRUE(m_breaker.AllowWrite());
+
+    m_breaker.RecordFailure();
+    EXPECT_TRUE(m_breaker.IsOpen());
+    EXPECT_FALSE(m_breaker.AllowWrite());
+}
+
+TEST_F(CircuitBreakerTest, SuccessResetsTheFailureCount)
+{
+    m_breaker.RecordFailure();
+    m_breaker.RecordFailure();
+    m_breaker.RecordSuccess();
+    m_breaker.RecordFailure();
+    m_breaker.RecordFailure();
+    EXPECT_FALSE(m_breaker.IsOpen());
+}
+
+TEST_F(CircuitBreakerTest, ProbesOnceTheBackoffHasPassed)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        m_breaker.RecordFailure();
+    }
+
+    m_now = 99ms;
+    EXPECT_FALSE(m_breaker.AllowWrite());
+    m_now = 100ms;
+    EXPECT_TRUE(m_breaker.AllowWrite());
+    // Only one write probes at a time
+    EXPECT_FALSE(m_breaker.AllowWrite());
+
+    m_breaker.RecordSuccess();
+    EXPECT_FALSE(m_breaker.IsOpen());
+    EXPECT_TRUE(m_breaker.AllowWrite());
+}
+
+TEST_F(CircuitBreakerTest, BackoffDoublesUpToTheMaximum)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        m_breaker.RecordFailure();
+    }
+
+    // Failed probes at 100ms, then 200ms and 400ms later, after which the backoff stays at 400ms
+    const std::chrono::milliseconds probes[] = {100ms, 300ms, 700ms, 1100ms, 1500ms};
+    for (const auto probe : probes)
+    {
+        m_now = probe - 1ms;
+        EXPECT_FALSE(m_breaker.AllowWrite()) << "at " << m_now.count() << "ms";
+        m_now = probe;
+        EXPECT_TRUE(m_breaker.AllowWrite()) << "at " << m_now.count() << "ms";
+        m_breaker.RecordFailure();
+        EXPECT_TRUE(m_breaker.IsOpen());
+    }
+}
+
+TEST(CircuitBreakerWriterTest, MissingSocketShortCircuitsWrites)
+{
+    UDSWriter writer("/tmp/test_uds_socket_missing");
+    constexpr auto numMessages = 100;
+    for (int i = 0; i < numMessages; i++)
+    {
+        writer.Write("c:counter:1");
+    }
+
+    // After the first failures the circuit opens, and the remaining writes are refused, but counted all the same
+    EXPECT_EQ(writer.GetDroppedLines(), static_cast<uint64_t>(numMessages));
+}
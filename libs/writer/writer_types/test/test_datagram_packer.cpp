@@ -0,0 +1,86 @@
+#include <datagram_packer.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace spectator;
+
+namespace {
+
+std::vector<std::string> ToVector(const DatagramPacker& packer)
+{
+    const auto datagrams = packer.Datagrams();
+    return {datagrams.begin(), datagrams.end()};
+}
+
+}  // namespace
+
+TEST(DatagramPackerTest, Empty)
+{
+    DatagramPacker packer;
+    EXPECT_TRUE(packer.IsEmpty());
+    EXPECT_EQ(packer.GetMaxPayload(), DatagramPacker::MaxUdpPayload);
+    EXPECT_TRUE(packer.Datagrams().empty());
+}
+
+TEST(DatagramPackerTest, LinesShareADatagram)
+{
+    DatagramPacker packer(100);
+    packer.Add("c:counter:1");
+    packer.Add("g:gauge:2");
+    EXPECT_EQ(ToVector(packer), (std::vector<std::string>{"c:counter:1\ng:gauge:2\n"}));
+}
+
+TEST(DatagramPackerTest, NeverSplitsLines)
+{
+    // Each line takes 10 bytes with its newline, so three fit into a 25 byte datagram
+    DatagramPacker packer(25);
+    for (int i = 0; i < 5; i++)
+    {
+        packer.Add("c:name:" + std::to_string(i) + "0");
+    }
+    EXPECT_EQ(ToVector(packer), (std::vector<std::string>{"c:name:00\nc:name:10\n", "c:name:20\nc:name:30\n",
+                                                          "c:name:40\n"}));
+}
+
+TEST(DatagramPackerTest, ExactFit)
+{
+    DatagramPacker packer(20);
+    packer.Add("c:name:00");
+    packer.Add("c:name:10");
+    packer.Add("c:name:20");
+    EXPECT_EQ(ToVector(packer), (std::vector<std::string>{"c:name:00\nc:name:10\n", "c:name:20\n"}));
+}
+
+TEST(DatagramPackerTest, OversizedLineGetsItsOwnDatagram)
+{
+    DatagramPacker packer(10);
+    packer.Add("c:a:1");
+    packer.Add("c:much.too.long.name:1");
+    packer.Add("c:b:1");
+    EXPECT_EQ(ToVector(packer), (std::vector<std::string>{"c:a:1\n", "c:much.too.long.name:1\n", "c:b:1\n"}));
+}
+
+TEST(DatagramPackerTest, AddLines)
+{
+    DatagramPacker packer(25);
+    packer.AddLines("c:name:00\nc:name:10\n");
+    packer.AddLines("c:name:20\nc:name:30\nc:name:40\n");
+    packer.AddLines("");
+    EXPECT_EQ(ToVector(packer), (std::vector<std::string>{"c:name:00\nc:name:10\n", "c:name:20\nc:name:30\n",
+                                                          "c:name:40\n"}));
+}
+
+TEST(DatagramPackerTest, ClearReusesDatagrams)
+{
+    DatagramPacker packer(10);
+    packer.Add("c:a:1");
+    packer.Add("c:b:1");
+    EXPECT_EQ(packer.Datagrams().size(), 2u);
+
+    packer.Clear();
+    EXPECT_TRUE(packer.IsEmpty());
+    packer.Add("c:c:1");
+    EXPECT_EQ(ToVector(packer), (std::vector<std::string>{"c:c:1\n"}));
+}
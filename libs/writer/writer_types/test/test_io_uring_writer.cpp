@@ -0,0 +1,309 @@
+#include <io_uring_writer.h>
+
+#include <gtest/gtest.h>
+#include "../test_utils/udp_server/udp_server.h"
+#include "../test_utils/uds_server/uds_server.h"
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace spectator;
+
+// Runs one of the test servers on its own thread for the duration of a test
+template <std::atomic<bool>& Running, void (*Listen)(), void (*Clear)()>
+class TestServer
+{
+   public:
+    void Start()
+    {
+        Clear();
+        Running = true;
+        m_thread = std::thread(Listen);
+
+        // Give the server time to start
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+
+    void Stop()
+    {
+        Running = false;
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+   private:
+    std::thread m_thread;
+};
+
+class IoUringWriterTest : public testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        if (false == IoUringWriter::IsSupported())
+        {
+            GTEST_SKIP() << "io_uring is not available";
+        }
+    }
+
+    static std::vector<std::string> MakeMessages(size_t count)
+    {
+        std::vector<std::string> messages;
+        for (size_t i = 0; i < count; i++)
+        {
+            messages.push_back("Batch message " + std::to_string(i));
+        }
+        return messages;
+    }
+
+    // Sends can complete out of order across submissions, so only the contents are compared
+    static void ExpectSameMessages(std::vector<std::string> received, std::vector<std::string> expected)
+    {
+        std::sort(received.begin(), received.end());
+        std::sort(expected.begin(), expected.end());
+        EXPECT_EQ(received, expected);
+    }
+
+    // A Unix domain socket that only receives when the test asks it to, so that sends pile up in the kernel
+    class StalledReceiver
+    {
+       public:
+        static constexpr auto Path = "/tmp/test_io_uring_stalled_socket";
+
+        StalledReceiver()
+        {
+            ::unlink(Path);
+            m_fd = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            std::strncpy(address.sun_path, Path, sizeof(address.sun_path) - 1);
+            ::bind(m_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+            // A lost datagram fails the test instead of hanging it
+            timeval timeout{2, 0};
+            ::setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        }
+
+        ~StalledReceiver()
+        {
+            ::close(m_fd);
+            ::unlink(Path);
+        }
+
+        // Receives up to count datagrams, giving up once none has arrived for a while
+        std::vector<std::string> Receive(size_t count)
+        {
+            std::vector<std::string> messages;
+            char buffer[2048];
+            while (messages.size() < count)
+            {
+                const auto size = ::recv(m_fd, buffer, sizeof(buffer), 0);
+                if (size < 0)
+                {
+                    break;
+                }
+                messages.emplace_back(buffer, static_cast<size_t>(size));
+            }
+            return messages;
+        }
+
+       private:
+        int m_fd = -1;
+    };
+
+    TestServer<udp_server_running, listen_for_udp_messages, clear_udp_messages> m_udpServer;
+    TestServer<uds_server_running, listen_for_uds_messages, clear_uds_messages> m_udsServer;
+};
+
+TEST_F(IoUringWriterTest, UdpSendMessage)
+{
+    m_udpServer.Start();
+    {
+        IoUringWriter writer("127.0.0.1", 12345);
+        writer.Write("Hello from IoUring Writer Test");
+    }
+
+    // Give time for the message to be processed
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const auto messages = get_udp_messages();
+    m_udpServer.Stop();
+
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_EQ(messages[0], "Hello from IoUring Writer Test");
+}
+
+TEST_F(IoUringWriterTest, UdpSendBatch)
+{
+    m_udpServer.Start();
+
+    // More messages than there are send buffers, so the writer has to wait for sends to complete
+    const auto test_messages = MakeMessages(100);
+    {
+        IoUringWriter writer("127.0.0.1", 12345);
+        writer.WriteBatch(test_messages);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    const auto received_messages = get_udp_messages();
+    m_udpServer.Stop();
+
+    ExpectSameMessages(received_messages, test_messages);
+}
+
+TEST_F(IoUringWriterTest, UdsSendBatch)
+{
+    m_udsServer.Start();
+
+    const auto test_messages = MakeMessages(100);
+    {
+        IoUringWriter writer("/tmp/test_uds_socket");
+        writer.WriteBatch(test_messages);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    const auto received_messages = get_uds_messages();
+    m_udsServer.Stop();
+
+    ExpectSameMessages(received_messages, test_messages);
+}
+
+TEST_F(IoUringWriterTest, UdsReconnectsWhenServerStartsLater)
+{
+    // The socket cannot be connected while there is no server
+    IoUringWriter writer("/tmp/test_uds_socket");
+    writer.Write("Message sent before server starts");
+
+    m_udsServer.Start();
+    writer.Write("Message sent after server starts");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    const auto messages = get_uds_messages();
+    m_udsServer.Stop();
+
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_EQ(messages[0], "Message sent after server starts");
+}
+
+TEST_F(IoUringWriterTest, UdsCountsFailedSendsAsDrops)
+{
+    m_udsServer.Start();
+    IoUringWriter writer("/tmp/test_uds_socket");
+    writer.Write("Message sent while the server runs");
+    EXPECT_EQ(1u, writer.GetSentDatagrams());
+    m_udsServer.Stop();
+
+    // The socket is still connected, so the send is submitted and fails when it completes
+    writer.WriteBatch(std::vector<std::string>{"Lost message", "Lost message"});
+    EXPECT_EQ(1u, writer.GetSentDatagrams());
+    EXPECT_EQ(2u, writer.GetDroppedLines());
+}
+
+TEST_F(IoUringWriterTest, UdsConcurrentWrites)
+{
+    m_udsServer.Start();
+
+    // Without a buffer, every application thread writes on its own
+    std::vector<std::string> test_messages;
+    {
+        IoUringWriter writer("/tmp/test_uds_socket");
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            for (int i = 0; i < 50; i++)
+            {
+                test_messages.push_back("Thread " + std::to_string(t) + " message " + std::to_string(i));
+            }
+            threads.emplace_back(
+                [&writer, t]
+                {
+                    for (int i = 0; i < 50; i++)
+                    {
+                        writer.Write("Thread " + std::to_string(t) + " message " + std::to_string(i));
+                    }
+                });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        // Sends still in flight when their thread exited are sent again
+        writer.Close();
+        EXPECT_EQ(200u, writer.GetSentDatagrams());
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    const auto received_messages = get_uds_messages();
+    m_udsServer.Stop();
+
+    ExpectSameMessages(received_messages, test_messages);
+}
+
+TEST_F(IoUringWriterTest, WritesDoNotWaitForSendsInFlight)
+{
+    StalledReceiver receiver;
+    SocketOptions options{};
+    options.sendBufferSize = 4096;
+    IoUringWriter writer(StalledReceiver::Path, options);
+
+    // The small send buffer fills after a few datagrams, but there are more send buffers than writes
+    const auto test_messages = MakeMessages(12);
+    std::atomic<bool> written{false};
+    std::thread producer(
+        [&]
+        {
+            for (const auto& message : test_messages)
+            {
+                writer.Write(message + std::string(1000, '.'));
+            }
+            written = true;
+        });
+    for (int i = 0; i < 200 && written.load() == false; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_TRUE(written.load());
+
+    // Once the producer has exited, its sends still in flight are sent again when the writer is closed
+    std::vector<std::string> received;
+    std::thread reader([&] { received = receiver.Receive(test_messages.size()); });
+    producer.join();
+    writer.Close();
+    reader.join();
+
+    EXPECT_EQ(test_messages.size(), writer.GetSentDatagrams());
+    EXPECT_EQ(0u, writer.GetDroppedLines());
+    ASSERT_EQ(received.size(), test_messages.size());
+    for (auto& message : received)
+    {
+        message.resize(message.find('.'));
+    }
+    ExpectSameMessages(received, test_messages);
+}
+
+TEST_F(IoUringWriterTest, NonBlockingWriterDropsWhenReceiverIsFull)
+{
+    StalledReceiver receiver;
+    SocketOptions options{};
+    options.nonBlocking = true;
+    options.sendBufferSize = 4096;
+    IoUringWriter writer(StalledReceiver::Path, options);
+
+    // Nothing is received, so the writes would block forever if the socket waited for room
+    const auto test_messages = MakeMessages(100);
+    for (const auto& message : test_messages)
+    {
+        writer.Write(message);
+    }
+    writer.Close();
+
+    EXPECT_GT(writer.GetSentDatagrams(), 0u);
+    EXPECT_GT(writer.GetDroppedLines(), 0u);
+    EXPECT_EQ(test_messages.size(), writer.GetSentDatagrams() + writer.GetDroppedLines());
+}
@@ -0,0 +1,74 @@
+#include <line_aggregator.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace spectator;
+
+namespace {
+
+std::string Flush(LineAggregator& aggregator)
+{
+    DatagramPacker packer;
+    aggregator.Flush(packer);
+    std::string lines;
+    for (const auto& datagram : packer.Datagrams())
+    {
+        lines.append(datagram);
+    }
+    return lines;
+}
+
+}  // namespace
+
+TEST(LineAggregatorTest, SumsCounterDeltas)
+{
+    LineAggregator aggregator;
+    EXPECT_TRUE(aggregator.IsEmpty());
+    EXPECT_TRUE(aggregator.Add("c:requests,status=200:1"));
+    EXPECT_TRUE(aggregator.Add("c:requests,status=500:1"));
+    EXPECT_TRUE(aggregator.Add("c:requests,status=200:2.5"));
+    EXPECT_TRUE(aggregator.Add("c:requests,status=200:1"));
+    EXPECT_FALSE(aggregator.IsEmpty());
+
+    EXPECT_EQ(Flush(aggregator), "c:requests,status=200:4.5\nc:requests,status=500:1\n");
+    EXPECT_TRUE(aggregator.IsEmpty());
+    EXPECT_EQ(Flush(aggregator), "");
+}
+
+TEST(LineAggregatorTest, KeepsLastGaugeAndLargestMaxGauge)
+{
+    LineAggregator aggregator;
+    EXPECT_TRUE(aggregator.Add("g:queue:7"));
+    EXPECT_TRUE(aggregator.Add("g,60:queue:1"));
+    EXPECT_TRUE(aggregator.Add("m:latency:3"));
+    EXPECT_TRUE(aggregator.Add("g:queue:2"));
+    EXPECT_TRUE(aggregator.Add("m:latency:9"));
+    EXPECT_TRUE(aggregator.Add("m:latency:-1"));
+
+    // A gauge with a TTL is another meter
+    EXPECT_EQ(Flush(aggregator), "g:queue:2\ng,60:queue:1\nm:latency:9\n");
+}
+
+TEST(LineAggregatorTest, LeavesOtherMetersAlone)
+{
+    LineAggregator aggregator;
+    EXPECT_FALSE(aggregator.Add("t:timer:0.5"));
+    EXPECT_FALSE(aggregator.Add("d:summary:10"));
+    EXPECT_FALSE(aggregator.Add("T:pct.timer:0.5"));
+    EXPECT_FALSE(aggregator.Add("D:pct.summary:10"));
+    EXPECT_FALSE(aggregator.Add("C:monotonic:10"));
+    EXPECT_FALSE(aggregator.Add("c:counter:not-a-number"));
+    EXPECT_FALSE(aggregator.Add("garbage"));
+    EXPECT_TRUE(aggregator.IsEmpty());
+}
+
+TEST(LineAggregatorTest, TakesValuesForKnownPrefixes)
+{
+    LineAggregator aggregator;
+    EXPECT_TRUE(aggregator.Add("c:counter:", 1));
+    EXPECT_TRUE(aggregator.Add("c:counter:1"));
+    EXPECT_FALSE(aggregator.Add("t:timer:", 1));
+    EXPECT_EQ(Flush(aggregator), "c:counter:2\n");
+}
@@ -3,6 +3,8 @@
 #include <gtest/gtest.h>
 
 #include "../test_utils/udp_server/udp_server.h"  // Include our new header for UDP server interaction
+#include <fmt/core.h>
+#include <sstream>
 #include <thread>
 #include <chrono>
 #include <algorithm>  // For std::find
@@ -152,6 +154,82 @@ TEST_F(UDPWriterTest, SendMultipleMessages)
     ASSERT_EQ(test_messages.at(2), received_messages.at(2));
 }
 
+TEST_F(UDPWriterTest, SendBatch)
+{
+    UDPWriter writer("127.0.0.1", 12345);
+
+    // More datagrams than fit into a single sendmmsg call
+    std::vector<std::string> test_messages;
+    for (int i = 0; i < 100; i++)
+    {
+        test_messages.push_back("Batch message " + std::to_string(i));
+    }
+    writer.WriteBatch(test_messages);
+
+    // Give time for messages to be processed
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    // Each message arrives as its own datagram, in order
+    const auto received_messages = get_udp_messages();
+    ASSERT_EQ(received_messages, test_messages);
+}
+
+TEST_F(UDPWriterTest, OversizeDatagramOnlyDropsItself)
+{
+    UDPWriter writer("127.0.0.1", 12345);
+
+    // Longer than any UDP datagram can be, so the kernel rejects it with EMSGSIZE
+    const std::vector<std::string> batch{"before", std::string(70000, 'x'), "after"};
+    writer.WriteBatch(batch);
+    writer.WriteBatch(batch);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    // The datagrams around it are sent, and the socket stays open for the next batch
+    const std::vector<std::string> expected{"before", "after", "before", "after"};
+    EXPECT_EQ(get_udp_messages(), expected);
+    EXPECT_EQ(writer.GetSentDatagrams(), 4u);
+    EXPECT_EQ(writer.GetDroppedLines(), 2u);
+}
+
+TEST_F(UDPWriterTest, SendBatchWithSegmentation)
+{
+    constexpr size_t segmentSize = 64;
+    SocketOptions options{};
+    options.udpSegmentSize = segmentSize;
+    UDPWriter writer("127.0.0.1", 12345, options);
+
+    // Lines of 25 bytes, so two fit into a segment and the rest of it is padding
+    std::vector<std::string> expected_lines;
+    std::string batch;
+    for (int i = 0; i < 200; i++)
+    {
+        const auto line = fmt::format("c:segment.counter:{:07}", i);
+        expected_lines.push_back(line);
+        batch.append(line).push_back('\n');
+    }
+    writer.WriteBatch(std::vector<std::string>{batch});
+
+    // Give time for messages to be processed
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    // Without segmentation offload the writer falls back to plain datagrams, which hold the same lines
+    std::vector<std::string> received_lines;
+    for (const auto& msg : get_udp_messages())
+    {
+        EXPECT_LE(msg.size(), segmentSize);
+        std::stringstream ss(msg);
+        std::string line;
+        while (std::getline(ss, line))
+        {
+            if (line.empty() == false)
+            {
+                received_lines.push_back(line);
+            }
+        }
+    }
+    EXPECT_EQ(received_lines, expected_lines);
+}
+
 TEST_F(UDPWriterTest, ClientReconnectsWhenServerStartsLater)
 {
     // First, stop the server that was started in SetUp
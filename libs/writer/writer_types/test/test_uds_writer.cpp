@@ -5,6 +5,7 @@
 #include <thread>
 #include <chrono>
 #include <algorithm>
+#include <cstdio>
 
 using namespace spectator;
 
@@ -153,6 +154,45 @@ TEST_F(UDSWriterTest, SendMultipleMessages)
     }
 }
 
+TEST_F(UDSWriterTest, SendBatch)
+{
+    UDSWriter writer("/tmp/test_uds_socket");
+
+    // More datagrams than fit into a single sendmmsg call
+    std::vector<std::string> test_messages;
+    for (int i = 0; i < 100; i++)
+    {
+        test_messages.push_back("Batch message " + std::to_string(i));
+    }
+    writer.WriteBatch(test_messages);
+
+    // Give time for messages to be processed
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    // Each message arrives as its own datagram, in order
+    const auto received_messages = get_uds_messages();
+    ASSERT_EQ(received_messages, test_messages);
+}
+
+TEST_F(UDSWriterTest, OversizeDatagramOnlyDropsItself)
+{
+    // A datagram larger than the send buffer is rejected with EMSGSIZE
+    SocketOptions options{};
+    options.sendBufferSize = 4096;
+    UDSWriter writer("/tmp/test_uds_socket", options);
+
+    const std::vector<std::string> batch{"before", std::string(20000, 'x'), "after"};
+    writer.WriteBatch(batch);
+    writer.WriteBatch(batch);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    // The datagrams around it are sent, and the socket stays open for the next batch
+    const std::vector<std::string> expected{"before", "after", "before", "after"};
+    EXPECT_EQ(get_uds_messages(), expected);
+    EXPECT_EQ(writer.GetSentDatagrams(), 4u);
+    EXPECT_EQ(writer.GetDroppedLines(), 2u);
+}
+
 TEST_F(UDSWriterTest, ClientReconnectsWhenServerStartsLater)
 {
     // First, stop the server that was started in SetUp
@@ -192,4 +232,62 @@ TEST_F(UDSWriterTest, ClientReconnectsWhenServerStartsLater)
     messages = get_uds_messages();
     EXPECT_TRUE(messages.size() == 1);
     EXPECT_TRUE(messages.at(0) == test_message_after);
-}
\ No newline at end of file
+}
+
+TEST_F(UDSWriterTest, ReconnectsWhenServerRestarts)
+{
+    UDSWriter writer("/tmp/test_uds_socket");
+    writer.Write("Message before restart");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // The restarted server binds a new socket file, so the connected socket is refused
+    StopServer();
+    StartServer();
+    clear_uds_messages();
+    writer.Write("Message refused after restart");
+
+    // The failed send closed the socket, and this write connects to the new server
+    const std::string test_message_after = "Message after reconnecting";
+    writer.Write(test_message_after);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    const auto messages = get_uds_messages();
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_EQ(messages.at(0), test_message_after);
+}
+
+TEST_F(UDSWriterTest, NonBlockingWriterDropsWhenReceiverIsFull)
+{
+    // A receiver that never reads, so its queue fills up
+    const std::string socketPath = "/tmp/test_uds_socket_full";
+    std::remove(socketPath.c_str());
+    boost::asio::io_context ioContext;
+    boost::asio::local::datagram_protocol::socket receiver(ioContext,
+                                                           boost::asio::local::datagram_protocol::endpoint(socketPath));
+
+    SocketOptions options{};
+    options.nonBlocking = true;
+    options.sendBufferSize = 4096;
+    UDSWriter writer(socketPath, options);
+
+    constexpr auto numMessages = 1000;
+    const std::string message(100, 'x');
+    for (int i = 0; i < numMessages; i++)
+    {
+        writer.Write(message);
+    }
+    EXPECT_GT(writer.GetDroppedLines(), 0u);
+    EXPECT_EQ(writer.GetDroppedBytes(), writer.GetDroppedLines() * message.size());
+
+    // Every message was either queued at the receiver or counted as dropped
+    receiver.non_blocking(true);
+    uint64_t received = 0;
+    char buffer[128];
+    boost::system::error_code ec;
+    while (receiver.receive(boost::asio::buffer(buffer), 0, ec) > 0 && !ec)
+    {
+        received++;
+    }
+    EXPECT_EQ(received + writer.GetDroppedLines(), static_cast<uint64_t>(numMessages));
+    std::remove(socketPath.c_str());
+}
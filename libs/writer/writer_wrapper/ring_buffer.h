@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace spectator {
+
+/**
+ * RingBuffer - A bounded, lock-free, multi-producer / single-consumer queue of lines
+ *
+ * Each line is stored as a 4-byte header followed by its bytes, padded to an 8-byte boundary. Producers reserve a
+ * record by advancing the write position with a compare-and-swap, which never waits on other producers. They then
+ * copy their line and publish it by storing the header with release semantics. The consumer reads records in order
+ * and stops at the first one whose header is still zero, so it only ever sees whole, committed lines. Consumed space
+ * is zeroed before it is handed back to producers.
+ *
+ * The write position (shared by producers) and the read position (owned by the consumer) are kept on separate cache
+ * lines so that producers and the consumer do not false-share.
+ */
+class RingBuffer
+{
+   public:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t MIN_CAPACITY = 4096;
+
+    // The capacity is rounded up to a power of two of at least MIN_CAPACITY bytes
+    explicit RingBuffer(size_t capacity)
+        : m_capacity(RoundUpCapacity(capacity)),
+          m_mask(m_capacity - 1),
+          m_words(std::make_unique<uint32_t[]>(m_capacity / sizeof(uint32_t)))
+    {
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    // Copies the line into the buffer. Returns false, without blocking, if there is not enough free space.
+    // Safe to call from any number of threads.
+    bool TryPush(std::string_view line) noexcept
+    {
+        const uint64_t recordSize = RecordSize(line.size());
+        if (recordSize > m_capacity)
+        {
+            return false;
+        }
+
+        uint64_t pos = m_writePos.load(std::memory_order_relaxed);
+        do
+        {
+            // Acquire pairs with the consumer's release of the read position, so the zeroed space is visible
+            if (pos + recordSize - m_readPos.load(std::memory_order_acquire) > m_capacity)
+            {
+                return false;
+            }
+        } while (m_writePos.compare_exchange_weak(pos, pos + recordSize, std::memory_order_relaxed) == false);
+
+        CopyIn(pos + HEADER_SIZE, line);
+        Header(pos).store(static_cast<uint32_t>(line.size()) + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Passes committed lines, oldest first, to onLine until the buffer has no more committed lines or at least
+    // maxBytes of line data have been consumed. Returns the number of bytes of line data consumed. Only one thread
+    // may consume at a time.
+    template <typename F>
+    size_t Consume(F&& onLine, size_t maxBytes)
+    {
+        const uint64_t start = m_readPos.load(std::memory_order_relaxed);
+        const uint64_t end = m_writePos.load(std::memory_order_acquire);
+        uint64_t pos = start;
+        size_t consumed = 0;
+        while (pos < end && consumed < maxBytes)
+        {
+            const uint32_t header = Header(pos).load(std::memory_order_acquire);
+            if (header == 0)
+            {
+                break;
+            }
+            const size_t size = header - 1;
+            onLine(LineAt(pos + HEADER_SIZE, size));
+            consumed += size;
+            pos += RecordSize(size);
+        }
+
+        if (pos != start)
+        {
+            Zero(start, pos);
+            m_readPos.store(pos, std::memory_order_release);
+        }
+        return consumed;
+    }
+
+    // Bytes currently reserved by producers and not yet consumed, including record overhead
+    size_t Size() const noexcept
+    {
+        return static_cast<size_t>(m_writePos.load(std::memory_order_acquire) -
+                                   m_readPos.load(std::memory_order_acquire));
+    }
+
+    bool IsEmpty() const noexcept { return Size() == 0; }
+
+    size_t Capacity() const noexcept { return m_capacity; }
+
+    // Space a line of the given size takes up in the buffer
+    static constexpr size_t RecordSize(size_t lineSize) noexcept
+    {
+        return (HEADER_SIZE + lineSize + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+    }
+
+   private:
+    static constexpr size_t HEADER_SIZE = sizeof(uint32_t);
+    static constexpr size_t RECORD_ALIGNMENT = 8;
+
+    static size_t RoundUpCapacity(size_t capacity) noexcept
+    {
+        size_t rounded = MIN_CAPACITY;
+        while (rounded < capacity)
+        {
+            rounded <<= 1;
+        }
+        return rounded;
+    }
+
+    char* Bytes() const noexcept { return reinterpret_cast<char*>(m_words.get()); }
+
+    // Records start on 8-byte boundaries and the capacity is a multiple of 8, so a header never wraps
+    std::atomic_ref<uint32_t> Header(uint64_t pos) const noexcept
+    {
+        return std::atomic_ref<uint32_t>(m_words[(pos & m_mask) / sizeof(uint32_t)]);
+    }
+
+    void CopyIn(uint64_t pos, std::string_view line) const noexcept
+    {
+        const size_t offset = pos & m_mask;
+        const size_t first = std::min(line.size(), m_capacity - offset);
+        std::memcpy(Bytes() + offset, line.data(), first);
+        std::memcpy(Bytes(), line.data() + first, line.size() - first);
+    }
+
+    std::string_view LineAt(uint64_t pos, size_t size)
+    {
+        const size_t offset = pos & m_mask;
+        if (offset + size <= m_capacity)
+        {
+            return {Bytes() + offset, size};
+        }
+        // The line wraps around the end of the buffer, so it is stitched together in a scratch string
+        const size_t first = m_capacity - offset;
+        m_wrapped.assign(Bytes() + offset, first);
+        m_wrapped.append(Bytes(), size - first);
+        return m_wrapped;
+    }
+
+    void Zero(uint64_t start, uint64_t end) const noexcept
+    {
+        const size_t offset = start & m_mask;
+        const size_t size = end - start;
+        const size_t first = std::min(size, m_capacity - offset);
+        std::memset(Bytes() + offset, 0, first);
+        std::memset(Bytes(), 0, size - first);
+    }
+
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<uint32_t[]> m_words;
+    std::string m_wrapped;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_writePos{0};
+    // The class is cache line aligned, so its size is rounded up and nothing else shares this line
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_readPos{0};
+};
+
+}  // namespace spectator
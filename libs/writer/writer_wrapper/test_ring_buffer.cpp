@@ -0,0 +1,136 @@
+#include <ring_buffer.h>
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace spectator;
+
+namespace {
+
+std::vector<std::string> Drain(RingBuffer& ring, size_t maxBytes = SIZE_MAX)
+{
+    std::vector<std::string> lines;
+    ring.Consume([&lines](std::string_view line) { lines.emplace_back(line); }, maxBytes);
+    return lines;
+}
+
+}  // namespace
+
+TEST(RingBufferTest, CapacityIsRoundedUp)
+{
+    EXPECT_EQ(RingBuffer(0).Capacity(), RingBuffer::MIN_CAPACITY);
+    EXPECT_EQ(RingBuffer(5000).Capacity(), 8192u);
+    EXPECT_EQ(RingBuffer(8192).Capacity(), 8192u);
+}
+
+TEST(RingBufferTest, PushAndConsume)
+{
+    RingBuffer ring(4096);
+    EXPECT_TRUE(ring.IsEmpty());
+    EXPECT_TRUE(ring.TryPush("c:counter:1"));
+    EXPECT_TRUE(ring.TryPush(""));
+    EXPECT_TRUE(ring.TryPush("g:gauge:42"));
+    EXPECT_EQ(ring.Size(), RingBuffer::RecordSize(11) + RingBuffer::RecordSize(0) + RingBuffer::RecordSize(10));
+
+    auto lines = Drain(ring);
+    EXPECT_EQ(lines, (std::vector<std::string>{"c:counter:1", "", "g:gauge:42"}));
+    EXPECT_TRUE(ring.IsEmpty());
+    EXPECT_TRUE(Drain(ring).empty());
+}
+
+TEST(RingBufferTest, ConsumeStopsAtMaxBytes)
+{
+    RingBuffer ring(4096);
+    for (int i = 0; i < 5; i++)
+    {
+        ASSERT_TRUE(ring.TryPush("0123456789"));
+    }
+
+    // Consumption stops once the limit is reached, so the line that crosses it is still included
+    EXPECT_EQ(Drain(ring, 25).size(), 3u);
+    EXPECT_EQ(Drain(ring).size(), 2u);
+}
+
+TEST(RingBufferTest, FullBufferRejectsPushes)
+{
+    RingBuffer ring(4096);
+    const std::string line(100, 'x');
+    size_t pushed = 0;
+    while (ring.TryPush(line))
+    {
+        pushed++;
+    }
+    EXPECT_EQ(pushed, ring.Capacity() / RingBuffer::RecordSize(line.size()));
+    EXPECT_FALSE(ring.TryPush(std::string(ring.Capacity(), 'x')));
+
+    Drain(ring, 1);
+    EXPECT_TRUE(ring.TryPush(line));
+}
+
+TEST(RingBufferTest, LinesWrapAroundTheEnd)
+{
+    RingBuffer ring(4096);
+    // 33 bytes of line data takes a 40 byte record, which does not divide the capacity, so records wrap
+    for (int round = 0; round < 1000; round++)
+    {
+        const std::string line = "c:counter,round=" + std::to_string(round % 10) + ":1234567890123";
+        ASSERT_TRUE(ring.TryPush(line));
+        ASSERT_TRUE(ring.TryPush(line));
+        EXPECT_EQ(Drain(ring), (std::vector<std::string>{line, line}));
+    }
+}
+
+TEST(RingBufferTest, MultipleProducers)
+{
+    constexpr int NUM_THREADS = 4;
+    constexpr int LINES_PER_THREAD = 20000;
+    RingBuffer ring(4096);
+
+    std::atomic<int> running{NUM_THREADS};
+    std::vector<std::thread> producers;
+    for (int t = 0; t < NUM_THREADS; t++)
+    {
+        producers.emplace_back(
+            [&ring, &running, t]
+            {
+                for (int i = 0; i < LINES_PER_THREAD; i++)
+                {
+                    const std::string line = std::to_string(t) + ":" + std::to_string(i);
+                    while (ring.TryPush(line) == false)
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+                running--;
+            });
+    }
+
+    // Each producer's lines must come out complete and in the order that producer pushed them
+    std::vector<int> next(NUM_THREADS, 0);
+    int total = 0;
+    auto check = [&next, &total](std::string_view line)
+    {
+        const auto colon = line.find(':');
+        ASSERT_NE(colon, std::string_view::npos);
+        const int t = std::stoi(std::string(line.substr(0, colon)));
+        const int i = std::stoi(std::string(line.substr(colon + 1)));
+        EXPECT_EQ(i, next[t]);
+        next[t] = i + 1;
+        total++;
+    };
+    while (running.load() > 0 || ring.IsEmpty() == false)
+    {
+        ring.Consume(check, SIZE_MAX);
+    }
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+    EXPECT_EQ(total, NUM_THREADS * LINES_PER_THREAD);
+}
@@ -1,6 +1,10 @@
+#include <age_gauge.h>
 #include <counter.h>
+#include <gauge.h>
 #include <logger.h>
 #include <meter_id.h>
+#include <monotonic_counter_uint.h>
+#include <timer.h>
 #include <writer_test_helper.h>
 
 #include <gtest/gtest.h>
@@ -9,6 +13,16 @@
 #include <thread>
 #include <chrono>
 #include <algorithm>
+#include <regex>
+#include <sstream>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "../writer_types/test_utils/uds_server/uds_server.h"
 
@@ -109,7 +123,7 @@ TEST_F(WriterWrapperUDSWriterTest, MultithreadedWrite)
     int actualIncrements = 0;
 
     // Verify every string in msgs follows the form counter.thread<digit>.<digit>
-    std::regex counter_regex(R"(c:counter\.thread\d+\.\d+:1.000000)");
+    std::regex counter_regex(R"(c:counter\.thread\d+\.\d+:1)");
     for (const auto& msg : msgs)
     {
         std::stringstream ss(msg);
@@ -191,4 +205,626 @@ TEST_F(WriterWrapperUDSWriterTest, TenThreadsBufferSize10Messages)
         EXPECT_EQ(msg.size(), 21);
     }
 }
-*/
\ No newline at end of file
+*/
+namespace {
+
+std::vector<std::string> SplitLines(const std::vector<std::string>& msgs)
+{
+    std::vector<std::string> lines;
+    for (const auto& msg : msgs)
+    {
+        std::stringstream ss(msg);
+        std::string line;
+        while (std::getline(ss, line))
+        {
+            lines.push_back(line);
+        }
+    }
+    return lines;
+}
+
+}  // namespace
+
+TEST(WriterWrapperThreadLocalTest, ExitedThreadsAreFlushed)
+{
+    WriterOptions options{};
+    options.bufferSize = 100;
+    options.threadLocalBuffers = true;
+    options.flushInterval = std::chrono::milliseconds(20);
+    WriterTestHelper::InitializeWriter(WriterType::Memory, "", 0, options);
+
+    constexpr auto numThreads = 4;
+    constexpr auto incrementsPerThread = 25;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; i++)
+    {
+        threads.emplace_back(
+            [i]
+            {
+                Counter counter(MeterId(fmt::format("counter.thread{}", i)));
+                for (int j = 0; j < incrementsPerThread; j++)
+                {
+                    counter.Increment();
+                }
+            });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    // The threads have exited with partially filled buffers, which the next sweeps pick up
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    WriterTestHelper::StopSending();
+
+    auto* memoryWriter = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    ASSERT_NE(memoryWriter, nullptr);
+    std::regex counter_regex(R"(c:counter\.thread\d:1)");
+    const auto lines = SplitLines(memoryWriter->GetMessages());
+    for (const auto& line : lines)
+    {
+        EXPECT_TRUE(std::regex_match(line, counter_regex)) << "Unexpected counter format: " << line;
+    }
+    EXPECT_EQ(lines.size(), numThreads * incrementsPerThread);
+}
+
+TEST(WriterWrapperThreadLocalTest, FullBuffersAreSentBeforeTheSweep)
+{
+    WriterOptions options{};
+    options.bufferSize = 100;
+    options.threadLocalBuffers = true;
+    options.flushInterval = std::chrono::hours(1);
+    // Full buffers waiting together are packed into the same datagram if they fit, which these do not
+    options.maxDatagramSize = 110;
+    WriterTestHelper::InitializeWriter(WriterType::Memory, "", 0, options);
+
+    // Each line is 17 bytes with its newline, so every sixth line fills a buffer
+    Counter counter(MeterId("counter.full"));
+    for (int i = 0; i < 20; i++)
+    {
+        counter.Increment();
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    WriterTestHelper::StopSending();
+
+    auto* memoryWriter = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    ASSERT_NE(memoryWriter, nullptr);
+    const auto& msgs = memoryWriter->GetMessages();
+    ASSERT_EQ(msgs.size(), 3u);
+    for (const auto& msg : msgs)
+    {
+        EXPECT_EQ(msg.size(), 102u);
+    }
+    EXPECT_EQ(SplitLines(msgs).size(), 18u);
+}
+
+// A clock that only moves when the test advances it
+class LingerTest : public testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        WriterOptions options{};
+        options.bufferSize = 1000;
+        options.maxLinger = std::chrono::seconds(1);
+        options.clock = [this] { return std::chrono::steady_clock::time_point(std::chrono::milliseconds(m_now.load())); };
+        WriterTestHelper::InitializeWriter(WriterType::Memory, "", 0, options);
+    }
+
+    void TearDown() override { WriterTestHelper::StopSending(); }
+
+    // Lets the sending thread see the lines written so far, then moves the clock forward and lets it react again
+    void Advance(std::chrono::milliseconds duration)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        m_now += duration.count();
+        WriterTestHelper::WakeSender();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    static std::vector<std::string> SentMessages()
+    {
+        WriterTestHelper::StopSending();
+        return dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl())->GetMessages();
+    }
+
+    std::atomic<int64_t> m_now{0};
+};
+
+TEST_F(LingerTest, NotSentBeforeDeadline)
+{
+    Counter counter(MeterId("counter.linger"));
+    counter.Increment();
+    Advance(std::chrono::milliseconds(999));
+
+    EXPECT_TRUE(SentMessages().empty());
+}
+
+TEST_F(LingerTest, SentAtDeadlineOfOldestLine)
+{
+    Counter counter(MeterId("counter.linger"));
+    counter.Increment();
+    Advance(std::chrono::milliseconds(600));
+    counter.Increment();
+    Advance(std::chrono::milliseconds(400));
+
+    const auto msgs = SentMessages();
+    ASSERT_EQ(msgs.size(), 1u);
+    EXPECT_EQ(msgs[0], "c:counter.linger:1\nc:counter.linger:1\n");
+}
+
+TEST_F(LingerTest, DeadlineRestartsAfterFlush)
+{
+    Counter counter(MeterId("counter.linger"));
+    counter.Increment();
+    Advance(std::chrono::milliseconds(1000));
+    counter.Increment();
+    Advance(std::chrono::milliseconds(500));
+    counter.Increment();
+    Advance(std::chrono::milliseconds(499));
+
+    const auto msgs = SentMessages();
+    ASSERT_EQ(msgs.size(), 1u);
+    EXPECT_EQ(msgs[0], "c:counter.linger:1\n");
+}
+
+TEST(WriterWrapperDatagramTest, BufferedLinesArePackedIntoDatagrams)
+{
+    WriterOptions options{};
+    options.bufferSize = 100;
+    options.threadLocalBuffers = true;
+    options.flushInterval = std::chrono::milliseconds(20);
+    options.maxDatagramSize = 40;
+    WriterTestHelper::InitializeWriter(WriterType::Memory, "", 0, options);
+
+    // Each line is 17 bytes with its newline, so two of them fit into a datagram
+    Counter counter(MeterId("counter.pack"));
+    for (int i = 0; i < 5; i++)
+    {
+        counter.Increment();
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    WriterTestHelper::StopSending();
+
+    auto* memoryWriter = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    ASSERT_NE(memoryWriter, nullptr);
+    const auto& msgs = memoryWriter->GetMessages();
+    ASSERT_EQ(msgs.size(), 3u);
+    EXPECT_EQ(msgs[0], "c:counter.pack:1\nc:counter.pack:1\n");
+    EXPECT_EQ(msgs[1], "c:counter.pack:1\nc:counter.pack:1\n");
+    EXPECT_EQ(msgs[2], "c:counter.pack:1\n");
+}
+
+TEST(WriterWrapperDatagramTest, UnbufferedLinesArePackedOnEveryCall)
+{
+    WriterOptions options{};
+    options.maxDatagramSize = 40;
+    WriterTestHelper::InitializeWriter(WriterType::Memory, "", 0, options);
+
+    // The packer is reused, so the second call must not resend the lines of the first
+    const std::vector<std::string> first{"c:counter.a:1", "c:counter.b:1", "c:counter.c:1"};
+    const std::vector<std::string> second{"c:counter.d:1"};
+    WriterTestHelper::WriteLines(first);
+    WriterTestHelper::WriteLines(second);
+
+    auto* memoryWriter = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    ASSERT_NE(memoryWriter, nullptr);
+    const auto& msgs = memoryWriter->GetMessages();
+    ASSERT_EQ(msgs.size(), 3u);
+    EXPECT_EQ(msgs[0], "c:counter.a:1\nc:counter.b:1\n");
+    EXPECT_EQ(msgs[1], "c:counter.c:1\n");
+    EXPECT_EQ(msgs[2], "c:counter.d:1\n");
+}
+
+namespace {
+
+// Records batches like the MemoryWriter, but the first batch stalls until the test releases it, as a sidecar that
+// cannot keep up would
+class StalledWriter final : public BaseWriter
+{
+   public:
+    void Write(const std::string& message) override { WriteBatch(std::span<const std::string>(&message, 1)); }
+
+    void WriteBatch(std::span<const std::string> messages) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_stalled == false; });
+        m_messages.insert(m_messages.end(), messages.begin(), messages.end());
+    }
+
+    void Close() override {}
+
+    void Release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stalled = false;
+        }
+        m_cv.notify_all();
+    }
+
+    std::vector<std::string> GetMessages()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_messages;
+    }
+
+   private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stalled = true;
+    std::vector<std::string> m_messages;
+};
+
+// Writes more lines than the ring holds while the sender is stalled, then returns every line that was sent
+std::vector<std::string> OverflowRing(OverflowPolicy policy, int numLines)
+{
+    WriterOptions options{};
+    options.bufferSize = 1000;
+    options.maxLinger = std::chrono::milliseconds(20);
+    options.overflowPolicy = policy;
+    WriterTestHelper::InitializeWriter(WriterType::Memory, "", 0, options);
+    auto stalled = std::make_unique<StalledWriter>();
+    auto* writer = stalled.get();
+    WriterTestHelper::SetImpl(std::move(stalled));
+
+    for (int i = 0; i < numLines; i++)
+    {
+        WriterTestHelper::Write(fmt::format("line.{:05d}", i));
+    }
+
+    writer->Release();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    WriterTestHelper::StopSending();
+    return SplitLines(writer->GetMessages());
+}
+
+}  // namespace
+
+TEST(WriterWrapperOverflowTest, DropNewestKeepsTheOldestLines)
+{
+    constexpr auto numLines = 10000;
+    const auto lines = OverflowRing(OverflowPolicy::DropNewest, numLines);
+    const auto stats = WriterTestHelper::GetStats();
+
+    EXPECT_GT(stats.droppedLines, 0u);
+    EXPECT_EQ(stats.droppedBytes, stats.droppedLines * 11);
+    EXPECT_EQ(lines.size() + stats.droppedLines, static_cast<size_t>(numLines));
+    ASSERT_FALSE(lines.empty());
+    EXPECT_EQ(lines.front(), "line.00000");
+    EXPECT_EQ(std::find(lines.begin(), lines.end(), "line.09999"), lines.end());
+}
+
+TEST(WriterWrapperOverflowTest, DropOldestKeepsTheNewestLines)
+{
+    constexpr auto numLines = 10000;
+    const auto lines = OverflowRing(OverflowPolicy::DropOldest, numLines);
+    const auto stats = WriterTestHelper::GetStats();
+
+    EXPECT_GT(stats.droppedLines, 0u);
+    EXPECT_EQ(stats.droppedBytes, stats.droppedLines * 11);
+    EXPECT_EQ(lines.size() + stats.droppedLines, static_cast<size_t>(numLines));
+    ASSERT_FALSE(lines.empty());
+    EXPECT_EQ(lines.back(), "line.09999");
+    EXPECT_TRUE(std::is_sorted(lines.begin(), lines.end()));
+}
+
+TEST(WriterWrapperOverflowTest, BlockParksTheProducerUntilThereIsSpace)
+{
+    WriterOptions options{};
+    options.bufferSize = 1000;
+    options.maxLinger = std::chrono::milliseconds(20);
+    WriterTestHelper::InitializeWriter(WriterType::Memory, "", 0, options);
+    auto stalled = std::make_unique<StalledWriter>();
+    auto* writer = stalled.get();
+    WriterTestHelper::SetImpl(std::move(stalled));
+
+    constexpr auto numLines = 10000;
+    std::thread producer(
+        []
+        {
+            for (int i = 0; i < numLines; i++)
+            {
+                WriterTestHelper::Write(fmt::format("line.{:05d}", i));
+            }
+        });
+
+    // The producer waits on the writer instead of spinning while the sender is stalled
+    for (int i = 0; i < 500 && WriterTestHelper::GetBlockedProducers() == 0; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(WriterTestHelper::GetBlockedProducers(), 1);
+
+    writer->Release();
+    producer.join();
+    EXPECT_TRUE(WriterTestHelper::Flush(std::chrono::seconds(5)));
+    WriterTestHelper::StopSending();
+    const auto lines = SplitLines(writer->GetMessages());
+    EXPECT_EQ(WriterTestHelper::GetStats().droppedLines, 0u);
+    ASSERT_EQ(lines.size(), static_cast<size_t>(numLines));
+    EXPECT_TRUE(std::is_sorted(lines.begin(), lines.end()));
+}
+
+TEST(WriterWrapperShutdownTest, ShutdownSendsWhatIsBuffered)
+{
+    WriterOptions options{};
+    options.bufferSize = 1000;
+    WriterTestHelper::InitializeWriter(WriterType::Memory, "", 0, options);
+
+    Counter counter(MeterId("counter.shutdown"));
+    counter.Increment();
+    counter.Increment();
+    EXPECT_TRUE(WriterTestHelper::Shutdown(std::chrono::seconds(1)));
+
+    auto* memoryWriter = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    ASSERT_NE(memoryWriter, nullptr);
+    ASSERT_EQ(memoryWriter->GetMessages().size(), 1u);
+    EXPECT_EQ(memoryWriter->GetMessages()[0], "c:counter.shutdown:1\nc:counter.shutdown:1\n");
+
+    // Without a sending thread, lines go straight to the transport
+    counter.Increment();
+    ASSERT_EQ(memoryWriter->GetMessages().size(), 2u);
+    EXPECT_EQ(memoryWriter->GetMessages()[1], "c:counter.shutdown:1\n");
+}
+
+TEST(WriterWrapperShutdownTest, FlushSendsPartiallyFilledThreadLocalBuffers)
+{
+    WriterOptions options{};
+    options.bufferSize = 1000;
+    options.threadLocalBuffers = true;
+    options.flushInterval = std::chrono::hours(1);
+    WriterTestHelper::InitializeWriter(WriterType::Memory, "", 0, options);
+
+    Counter counter(MeterId("counter.flush"));
+    counter.Increment();
+    EXPECT_TRUE(WriterTestHelper::Flush(std::chrono::seconds(1)));
+    WriterTestHelper::StopSending();
+
+    auto* memoryWriter = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    ASSERT_NE(memoryWriter, nullptr);
+    ASSERT_EQ(memoryWriter->GetMessages().size(), 1u);
+    EXPECT_EQ(memoryWriter->GetMessages()[0], "c:counter.flush:1\n");
+}
+
+TEST(WriterWrapperDeferredTest, SenderFormatsTheLines)
+{
+    WriterOptions options{};
+    options.bufferSize = 1000;
+    options.deferFormatting = true;
+    WriterTestHelper::InitializeWriter(WriterType::Memory, "", 0, options);
+
+    Counter counter(MeterId("counter.deferred", {{"tag", "value"}}));
+    counter.Increment();
+    counter.Increment(2.5);
+    Timer(MeterId("timer.deferred")).Record(0.125);
+    WriterTestHelper::Write("c:formatted.by.caller:1");
+    MonotonicCounterUint(MeterId("uint.deferred")).Set(18446744073709551615u);
+    Gauge(MeterId("gauge.deferred"), 60).Set(-3);
+    AgeGauge(MeterId("age.deferred")).Now();
+    EXPECT_TRUE(WriterTestHelper::Flush(std::chrono::seconds(1)));
+
+    auto* memoryWriter = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    ASSERT_NE(memoryWriter, nullptr);
+    ASSERT_EQ(memoryWriter->GetMessages().size(), 1u);
+    EXPECT_EQ(memoryWriter->GetMessages()[0],
+              "c:counter.deferred,tag=value:1\n"
+              "c:counter.deferred,tag=value:2.5\n"
+              "t:timer.deferred:0.125\n"
+              "c:formatted.by.caller:1\n"
+              "U:uint.deferred:18446744073709551615\n"
+              "g,60:gauge.deferred:-3\n"
+              "A:age.deferred:0\n");
+
+    // Once shut down, the line is formatted by the caller and sent right away
+    EXPECT_TRUE(WriterTestHelper::Shutdown(std::chrono::seconds(1)));
+    counter.Increment();
+    ASSERT_EQ(memoryWriter->GetMessages().size(), 2u);
+    EXPECT_EQ(memoryWriter->GetMessages()[1], "c:counter.deferred,tag=value:1\n");
+}
+
+TEST(WriterWrapperDeferredTest, CallerFormatsPastThePrefixLimit)
+{
+    WriterOptions options{};
+    options.bufferSize = 1000;
+    options.deferFormatting = true;
+    options.maxDeferredPrefixes = 2;
+    WriterTestHelper::InitializeWriter(WriterType::Memory, "", 0, options);
+
+    Counter first(MeterId("counter.first"));
+    Counter second(MeterId("counter.second"));
+    Counter third(MeterId("counter.third"));
+    for (int i = 0; i < 2; i++)
+    {
+        first.Increment();
+        second.Increment();
+        third.Increment();
+    }
+    EXPECT_TRUE(WriterTestHelper::Flush(std::chrono::seconds(1)));
+
+    auto* memoryWriter = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    ASSERT_NE(memoryWriter, nullptr);
+    ASSERT_EQ(memoryWriter->GetMessages().size(), 1u);
+    EXPECT_EQ(memoryWriter->GetMessages()[0],
+              "c:counter.first:1\n"
+              "c:counter.second:1\n"
+              "c:counter.third:1\n"
+              "c:counter.first:1\n"
+              "c:counter.second:1\n"
+              "c:counter.third:1\n");
+    EXPECT_TRUE(WriterTestHelper::Shutdown(std::chrono::seconds(1)));
+}
+
+TEST(WriterWrapperDeferredTest, ManyThreadsAndMeters)
+{
+    WriterOptions options{};
+    options.bufferSize = 4096;
+    options.deferFormatting = true;
+    WriterTestHelper::InitializeWriter(WriterType::Memory, "", 0, options);
+
+    constexpr int numThreads = 4;
+    constexpr int numLines = 5000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++)
+    {
+        threads.emplace_back(
+            [t]
+            {
+                for (int i = 0; i < numLines; i++)
+                {
+                    Counter(MeterId(fmt::format("counter.{}", i % 50), {{"thread", std::to_string(t)}})).Increment();
+                }
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    EXPECT_TRUE(WriterTestHelper::Flush(std::chrono::seconds(5)));
+    WriterTestHelper::StopSending();
+
+    auto* memoryWriter = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    ASSERT_NE(memoryWriter, nullptr);
+    std::map<std::string, int> counts;
+    for (const auto& message : memoryWriter->GetMessages())
+    {
+        std::istringstream lines(message);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            counts[line]++;
+        }
+    }
+    ASSERT_EQ(counts.size(), static_cast<size_t>(numThreads * 50));
+    EXPECT_EQ(counts["c:counter.7,thread=2:1"], numLines / 50);
+}
+
+static std::string CoalescedLines(const WriterOptions& options)
+{
+    WriterTestHelper::InitializeWriter(WriterType::Memory, "", 0, options);
+
+    Counter counter(MeterId("counter.coalesced"));
+    Gauge gauge(MeterId("gauge.coalesced"));
+    Timer timer(MeterId("timer.coalesced"));
+    for (int i = 0; i < 100; i++)
+    {
+        counter.Increment();
+        gauge.Set(i);
+        timer.Record(i < 2 ? i : 1);
+    }
+    EXPECT_TRUE(WriterTestHelper::Flush(std::chrono::seconds(1)));
+    WriterTestHelper::StopSending();
+
+    auto* memoryWriter = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    std::string lines;
+    for (const auto& message : memoryWriter->GetMessages())
+    {
+        lines.append(message);
+    }
+    return lines;
+}
+
+TEST(WriterWrapperCoalesceTest, OneLinePerCounterAndGaugeInABatch)
+{
+    WriterOptions options{};
+    options.bufferSize = 64 * 1024;
+    options.coalesce = true;
+    const auto lines = CoalescedLines(options);
+
+    // Timer samples all count, so they are sent one by one
+    EXPECT_EQ(std::count(lines.begin(), lines.end(), '\n'), 102);
+    EXPECT_NE(lines.find("c:counter.coalesced:100\n"), std::string::npos);
+    EXPECT_NE(lines.find("g:gauge.coalesced:99\n"), std::string::npos);
+    EXPECT_NE(lines.find("t:timer.coalesced:0\nt:timer.coalesced:1\n"), std::string::npos);
+}
+
+TEST(WriterWrapperCoalesceTest, CoalescesDeferredRecordsAndThreadLocalBuffers)
+{
+    for (const bool threadLocal : {false, true})
+    {
+        WriterOptions options{};
+        options.bufferSize = 64 * 1024;
+        options.coalesce = true;
+        options.deferFormatting = threadLocal == false;
+        options.threadLocalBuffers = threadLocal;
+        options.flushInterval = std::chrono::hours(1);
+        const auto lines = CoalescedLines(options);
+
+        EXPECT_EQ(std::count(lines.begin(), lines.end(), '\n'), 102);
+        EXPECT_NE(lines.find("c:counter.coalesced:100\n"), std::string::npos);
+        EXPECT_NE(lines.find("g:gauge.coalesced:99\n"), std::string::npos);
+    }
+}
+
+TEST(WriterWrapperForkTest, ChildGetsItsOwnSenderAndEmptyBuffers)
+{
+    WriterOptions options{};
+    options.bufferSize = 1000;
+    WriterTestHelper::InitializeWriter(WriterType::Memory, "", 0, options);
+
+    // Buffered in the parent when it forks
+    Counter parent(MeterId("counter.parent"));
+    parent.Increment();
+
+    const pid_t pid = fork();
+    ASSERT_NE(pid, -1);
+    if (pid == 0)
+    {
+        // Without a sending thread in the child, the flush would time out
+        Counter child(MeterId("counter.child"));
+        child.Increment();
+        const bool flushed = WriterTestHelper::Flush(std::chrono::seconds(1));
+        const auto* memoryWriter = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+        const bool onlyChild = memoryWriter != nullptr && memoryWriter->GetMessages().size() == 1 &&
+                               memoryWriter->GetMessages()[0] == "c:counter.child:1\n";
+        _exit(flushed && onlyChild ? 0 : 1);
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    // The parent's writer is untouched
+    EXPECT_TRUE(WriterTestHelper::Flush(std::chrono::seconds(1)));
+    const auto* memoryWriter = dynamic_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    ASSERT_NE(memoryWriter, nullptr);
+    ASSERT_EQ(memoryWriter->GetMessages().size(), 1u);
+    EXPECT_EQ(memoryWriter->GetMessages()[0], "c:counter.parent:1\n");
+    WriterTestHelper::StopSending();
+}
+
+TEST(WriterWrapperForkTest, ChildClosesTheInheritedSocket)
+{
+    const auto openFiles = []
+    {
+        const std::filesystem::directory_iterator fds("/proc/self/fd");
+        return std::distance(std::filesystem::begin(fds), std::filesystem::end(fds));
+    };
+
+    // The io_uring writer also has a ring, where the kernel supports it
+    for (const bool ioUring : {false, true})
+    {
+        WriterOptions options{};
+        options.bufferSize = 1000;
+        options.ioUring = ioUring;
+        WriterTestHelper::InitializeWriter(WriterType::UDP, "127.0.0.1", 12345, options);
+        const auto parentFiles = openFiles();
+
+        const pid_t pid = fork();
+        ASSERT_NE(pid, -1);
+        if (pid == 0)
+        {
+            // The child opened a socket of its own, so it must have closed the one it inherited
+            _exit(openFiles() == parentFiles ? 0 : 1);
+        }
+
+        int status = 0;
+        ASSERT_EQ(waitpid(pid, &status, 0), pid);
+        ASSERT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(WEXITSTATUS(status), 0) << "ioUring " << ioUring;
+        WriterTestHelper::StopSending();
+    }
+}
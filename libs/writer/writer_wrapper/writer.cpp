@@ -2,32 +2,198 @@
 
 #include <writer_types.h>
 #include <logger.h>
+#include <util.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <optional>
 #include <stdexcept>
 
+#include <pthread.h>
+
 namespace spectator {
 
 static constexpr auto NEW_LINE = '\n';
 
+// The ring holds several buffers worth of lines, so producers can keep writing while the sender drains one
+static constexpr size_t RING_BUFFERS = 4;
+static constexpr size_t MIN_RING_CAPACITY = 64 * 1024;
+
+// Block policy: how often a producer finding the ring full yields before it parks until the sender frees space
+static constexpr int SPINS_BEFORE_WAIT = 64;
+
+// Thread-local mode: full buffers waiting for the sending thread before the overflow policy applies
+static constexpr size_t MAX_FULL_BUFFERS = 16;
+
+thread_local Writer::LocalBufferHandles Writer::t_localBuffers;
+
+// Source of writer generations
+static std::atomic<uint64_t> s_generations{0};
+
+// Deferred formatting: a record is the prefix id, with the value kind in its top bits, followed by the value. With
+// the ring's header that is 16 bytes per line.
+static constexpr size_t RECORD_ID_SIZE = sizeof(uint32_t);
+static constexpr size_t RECORD_SIZE = RECORD_ID_SIZE + sizeof(uint64_t);
+static constexpr uint32_t KIND_SHIFT = 30;
+static constexpr uint32_t MAX_PREFIXES = 1u << KIND_SHIFT;
+static constexpr uint32_t NO_PREFIX_ID = 0xFFFFFFFF;  // Cached by meters that found the prefix table full
+
+Writer::LocalBufferHandles::~LocalBufferHandles()
+{
+    for (const auto& handle : handles)
+    {
+        std::lock_guard<std::mutex> lock(handle.buffer->mutex);
+        handle.buffer->orphaned = true;
+    }
+}
+
+static bool UseIoUring(const WriterOptions& options)
+{
+    if (options.ioUring == false)
+    {
+        return false;
+    }
+#ifdef __linux__
+    if (IoUringWriter::IsSupported())
+    {
+        return true;
+    }
+#endif
+    Logger::warn("io_uring or its send operations are not available, falling back to the regular writer");
+    return false;
+}
+
+template <typename... Args>
+static std::unique_ptr<BaseWriter> MakeIoUringWriter([[maybe_unused]] const Args&... args)
+{
+#ifdef __linux__
+    return std::make_unique<IoUringWriter>(args...);
+#else
+    return nullptr;
+#endif
+}
+
+// Every live writer, so that the fork handlers can reach them
+static std::mutex s_writersMutex;
+static std::vector<Writer*> s_writers;
+
+// Whether a Registry uses the default writer
+static std::mutex s_defaultMutex;
+static bool s_defaultAcquired = false;
+
+const std::shared_ptr<Writer>& Writer::DefaultPtr()
+{
+    static const auto writer = std::make_shared<Writer>();
+    return writer;
+}
+
+std::shared_ptr<Writer> Writer::Acquire()
+{
+    std::lock_guard<std::mutex> lock(s_defaultMutex);
+    if (s_defaultAcquired)
+    {
+        return std::make_shared<Writer>();
+    }
+    s_defaultAcquired = true;
+    return DefaultPtr();
+}
+
+void Writer::Release(const std::shared_ptr<Writer>& writer)
+{
+    // The default writer keeps its transport, so meters without a Registry still send, until the next Registry
+    // initializes it again
+    std::lock_guard<std::mutex> lock(s_defaultMutex);
+    if (writer == DefaultPtr())
+    {
+        s_defaultAcquired = false;
+    }
+}
+
+Writer::Writer()
+{
+    static std::once_flag forkHandlers;
+    std::call_once(forkHandlers,
+                   [] { pthread_atfork(&Writer::PrepareFork, &Writer::ResumeAfterFork, &Writer::RestartAfterFork); });
+
+    std::lock_guard<std::mutex> lock(s_writersMutex);
+    s_writers.push_back(this);
+}
+
 Writer::~Writer()
 {
-    auto& instance = GetInstance();
+    {
+        std::lock_guard<std::mutex> lock(s_writersMutex);
+        std::erase(s_writers, this);
+    }
 
-    if (instance.bufferingEnabled)
+    if (bufferingEnabled)
     {
-        instance.shutdown.store(true);
-        instance.cv_receiver.notify_all();
-        instance.cv_sender.notify_all();
-        if (instance.sendingThread.joinable()) {
-            instance.sendingThread.join();
+        // Send what is still buffered, e.g. the last metrics of a graceful deploy
+        Shutdown(shutdownTimeout);
+        StopSending();
+    }
+    if (m_impl)
+    {
+        this->Close();
+    }
+}
+
+void Writer::StopSending()
+{
+    if (sendingThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(writeMutex);
+            shutdown.store(true);
         }
+        cv_sender.notify_all();
+        cv_producers.notify_all();
+        cv_flushed.notify_all();
+        sendingThread.join();
     }
-    this->Close();
+    shutdown.store(false);
 }
 
 void Writer::Initialize(WriterType type, const std::string& param, int port, unsigned int bufferSize)
 {
-    // Get the singleton instance directly
-    auto& instance = GetInstance();
+    WriterOptions options{};
+    options.bufferSize = bufferSize;
+    Initialize(type, param, port, options);
+}
+
+void Writer::Initialize(WriterType type, const std::string& param, int port, const WriterOptions& options)
+{
+    const auto bufferSize = options.bufferSize;
+
+    // A writer that is initialized again must not leave its old sending thread behind
+    StopSending();
+    generation = ++s_generations;
+    {
+        std::lock_guard<std::mutex> lock(localBuffersMutex);
+        localBuffers.clear();
+    }
+    fullBuffers.clear();
+    {
+        std::lock_guard<std::mutex> lock(prefixesMutex);
+        prefixIds.clear();
+        prefixes.clear();
+    }
+    deferFormatting = false;
+    coalesce = false;
+    aggregator = LineAggregator();
+    flushesDone = flushRequests;
+    overflowPolicy = options.overflowPolicy;
+    shutdownTimeout = options.shutdownTimeout;
+    stopped.store(false);
+    droppedLines.store(0);
+    droppedBytes.store(0);
+
+    // A full socket buffer drops the datagram instead of stalling the caller, unless producers are meant to wait
+    SocketOptions socketOptions{};
+    socketOptions.nonBlocking = options.overflowPolicy != OverflowPolicy::Block;
+    socketOptions.sendBufferSize = options.sendBufferSize;
+    socketOptions.udpSegmentSize = options.udpSegmentSize;
 
     // Create the new writer based on type
     try
@@ -35,36 +201,75 @@ void Writer::Initialize(WriterType type, const std::string& param, int port, uns
         switch (type)
         {
             case WriterType::Memory:
-                instance.m_impl = std::make_unique<MemoryWriter>();
+                m_impl = std::make_unique<MemoryWriter>();
                 Logger::info("WriterWrapper initialized as MemoryWriter");
                 break;
             case WriterType::UDP:
-                instance.m_impl = std::make_unique<UDPWriter>(param, port);
+                if (UseIoUring(options))
+                {
+                    m_impl = MakeIoUringWriter(param, port, socketOptions);
+                    Logger::info("WriterWrapper initialized as IoUringWriter with host: {} and port: {}", param, port);
+                    break;
+                }
+                m_impl = std::make_unique<UDPWriter>(param, port, socketOptions);
                 Logger::info("WriterWrapper initialized as UDPWriter with host: {} and port: {}", param, port);
                 break;
             case WriterType::Unix:
-                instance.m_impl = std::make_unique<UDSWriter>(param);
+                if (UseIoUring(options))
+                {
+                    m_impl = MakeIoUringWriter(param, socketOptions);
+                    Logger::info("WriterWrapper initialized as IoUringWriter with socket path: {}", param);
+                    break;
+                }
+                m_impl = std::make_unique<UDSWriter>(param, socketOptions);
                 Logger::info("WriterWrapper initialized as UnixWriter with socket path: {}", param);
                 break;
             default:
                 throw std::runtime_error("Unsupported writer type");
         }
 
-        instance.m_currentType = type;
+        m_currentType = type;
+        m_location = param;
+        m_port = port;
+        m_options = options;
+        {
+            std::lock_guard<std::mutex> lock(linesMutex);
+            linesPacker = DatagramPacker(options.maxDatagramSize);
+        }
         
-        if (bufferSize > 0)
+        if (bufferSize > 0 && options.threadLocalBuffers)
         {
-            instance.bufferingEnabled = true;
-            instance.bufferSize = bufferSize;
-            instance.buffer.reserve(bufferSize);
-            instance.writeImpl = &Writer::BufferedWrite;
+            bufferingEnabled = true;
+            this->bufferSize = bufferSize;
+            flushInterval = options.flushInterval;
+            coalesce = options.coalesce;
+            packer = DatagramPacker(options.maxDatagramSize);
+            writeImpl = &Writer::ThreadLocalWrite;
+            sendingThread = std::thread(&Writer::ThreadSweep, this);
+        }
+        else if (bufferSize > 0)
+        {
+            bufferingEnabled = true;
+            this->bufferSize = bufferSize;
+            maxLinger = options.maxLinger;
+            clock = options.clock;
+            packer = DatagramPacker(options.maxDatagramSize);
+            lingerArmed.store(false);
+            deferFormatting = options.deferFormatting;
+            maxPrefixes = std::min(options.maxDeferredPrefixes.value_or(WriterOptions::DefaultMaxDeferredPrefixes),
+                                   static_cast<size_t>(MAX_PREFIXES));
+            coalesce = options.coalesce;
+            ring = std::make_unique<RingBuffer>(
+                std::max(RING_BUFFERS * static_cast<size_t>(bufferSize), MIN_RING_CAPACITY));
+            writeImpl = &Writer::BufferedWrite;
             // Create a thread with proper binding to the instance method
-            instance.sendingThread = std::thread(&Writer::ThreadSend, &instance);
+            sendingThread = std::thread(&Writer::ThreadSend, this);
         }
         else
         {
             // Explicitly set to non-buffered if buffer size is 0
-            instance.writeImpl = &Writer::NonBufferedWrite;
+            bufferingEnabled = false;
+            writeImpl = &Writer::NonBufferedWrite;
         }
     }
     catch (const std::exception& e)
@@ -74,52 +279,657 @@ void Writer::Initialize(WriterType type, const std::string& param, int port, uns
     }
 }
 
-void Writer::TryToSend(const std::string& message)
+void Writer::PrepareFork()
+{
+    // Other threads may be halfway through changing the buffers. Holding these locks across fork() means the child
+    // gets them in a consistent state. Producers in ring mode never take them, so they keep writing meanwhile.
+    s_writersMutex.lock();
+    for (auto* writer : s_writers)
+    {
+        writer->localBuffersMutex.lock();
+        writer->writeMutex.lock();
+        writer->consumeMutex.lock();
+        writer->prefixesMutex.lock();
+        writer->linesMutex.lock();
+    }
+}
+
+void Writer::ResumeAfterFork()
+{
+    for (auto* writer : s_writers)
+    {
+        writer->linesMutex.unlock();
+        writer->prefixesMutex.unlock();
+        writer->consumeMutex.unlock();
+        writer->writeMutex.unlock();
+        writer->localBuffersMutex.unlock();
+    }
+    s_writersMutex.unlock();
+}
+
+void Writer::RestartAfterFork()
+{
+    // The writers are created again below, and what they would log could deadlock the child
+    Logger::Muted muted;
+    new (&s_writersMutex) std::mutex();
+    for (auto* writer : s_writers)
+    {
+        writer->Restart();
+    }
+}
+
+void Writer::Restart()
 {
-    const auto& instance = GetInstance();
-    instance.m_impl->Write(message);
+    // Only the forking thread exists in the child. The sending thread is gone, and the condition variables may still
+    // count the parent's waiters, so they are all replaced without being joined or destroyed.
+    new (&sendingThread) std::thread();
+    new (&cv_sender) std::condition_variable();
+    new (&cv_producers) std::condition_variable();
+    new (&cv_flushed) std::condition_variable();
+    new (&linesMutex) std::mutex();
+    new (&prefixesMutex) std::mutex();
+    new (&consumeMutex) std::mutex();
+    new (&writeMutex) std::mutex();
+    new (&localBuffersMutex) std::mutex();
+    blockedProducers.store(0);
+
+    if (m_impl == nullptr)
+    {
+        return;
+    }
+
+    // The socket, and the io_uring ring, are shared with the parent, so the inherited writer only closes the child's
+    // copies. The lines buffered before the fork are the parent's to send, so the child starts out empty.
+    m_impl->CloseAfterFork();
+    m_impl.reset();
+    Initialize(m_currentType, m_location, m_port, m_options);
 }
 
+void Writer::TryToSend(const std::string& message) { m_impl->Write(message); }
+
 void Writer::ThreadSend()
 {
-    auto& instance = GetInstance();
-    std::string message{};
-    while (instance.shutdown.load() == false)
+    // Set once the sender learns that lines are buffered, and cleared when they are flushed
+    std::optional<std::chrono::steady_clock::time_point> lingerDeadline;
+    while (shutdown.load() == false)
     {
+        uint64_t flushTarget = 0;
         {
-            std::unique_lock<std::mutex> lock(instance.writeMutex);
-            instance.cv_sender.wait(
-                lock, [&instance] { return instance.buffer.size() >= instance.bufferSize || instance.shutdown.load(); });
-            if (instance.shutdown.load() == true)
+            std::unique_lock<std::mutex> lock(writeMutex);
+            const auto ready = [this, &lingerDeadline]
+            {
+                return sendRequested.load() || shutdown.load() || flushesDone != flushRequests ||
+                       (lingerArmed.load() && lingerDeadline.has_value() == false);
+            };
+            if (lingerDeadline.has_value())
+            {
+                // The injected clock decides when the deadline passes; the timed wait only makes sure we look again
+                cv_sender.wait_for(lock, *lingerDeadline - Now(), ready);
+            }
+            else
+            {
+                cv_sender.wait(lock, ready);
+            }
+            if (shutdown.load() == true)
             {
                 return;
             }
-            message = std::move(instance.buffer);
-            instance.buffer = std::string();
-            instance.buffer.reserve(instance.bufferSize);
+            flushTarget = flushRequests;
+        }
+        // Cleared before draining, so a line committed after this point requests another pass. The exchange also
+        // acquires the lines committed by the producer that requested this pass.
+        sendRequested.exchange(false);
+
+        const bool flushing = flushTarget != flushesDone;
+        size_t threshold = bufferSize;
+        if (flushing || (lingerDeadline.has_value() && Now() >= *lingerDeadline))
+        {
+            // Flush everything, however little. Lines written from now on arm a new deadline.
+            lingerDeadline.reset();
+            lingerArmed.exchange(false);
+            threshold = 1;
+        }
+        else if (lingerArmed.load() && lingerDeadline.has_value() == false)
+        {
+            lingerDeadline = Now() + maxLinger;
+        }
+
+        DrainRing(threshold);
+
+        if (threshold == 1 && maxLinger.count() > 0 && ring->IsEmpty() == false)
+        {
+            // A line was still being written during the flush and may have missed arming the deadline
+            lingerArmed.store(true);
+            lingerDeadline = Now() + maxLinger;
+        }
+
+        if (flushing)
+        {
+            CompleteFlush(flushTarget);
+        }
+    }
+}
+
+void Writer::DrainRing(size_t threshold)
+{
+    while (ring->Size() >= threshold && shutdown.load() == false)
+    {
+        packer.Clear();
+        {
+            std::lock_guard<std::mutex> lock(consumeMutex);
+            if (deferFormatting)
+            {
+                // One lock for the whole batch, which producers only contend for when they see a new meter
+                std::lock_guard<std::mutex> prefixesLock(prefixesMutex);
+                ring->Consume([this](std::string_view record) { PackRecord(record); }, bufferSize);
+            }
+            else
+            {
+                ring->Consume([this](std::string_view line) { Pack(line); }, bufferSize);
+            }
+        }
+        // Pairs with the fence in WaitForSpace, so either the producer sees the space or the sender sees the producer
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (blockedProducers.load(std::memory_order_relaxed) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(writeMutex);
+            }
+            cv_producers.notify_all();
+        }
+        if (packer.IsEmpty() && aggregator.IsEmpty())
+        {
+            // The oldest line is reserved but not committed yet; its producer will request another send
+            break;
+        }
+        SendPacked();
+    }
+}
+
+void Writer::CompleteFlush(uint64_t flushTarget)
+{
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        flushesDone = flushTarget;
+    }
+    cv_flushed.notify_all();
+}
+
+bool Writer::Flush(std::chrono::milliseconds timeout)
+{
+    if (bufferingEnabled == false || stopped.load())
+    {
+        // Every line has already been handed to the transport
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(writeMutex);
+    const uint64_t ticket = ++flushRequests;
+    cv_sender.notify_one();
+    cv_flushed.wait_for(lock, timeout, [this, ticket] { return flushesDone >= ticket || shutdown.load(); });
+    return flushesDone >= ticket;
+}
+
+bool Writer::Shutdown(std::chrono::milliseconds timeout)
+{
+    if (bufferingEnabled == false || stopped.load())
+    {
+        return true;
+    }
+
+    const bool flushed = Flush(timeout);
+    if (flushed == false)
+    {
+        Logger::warn("Writer: Buffered lines were not sent within {}ms of shutting down", timeout.count());
+    }
+
+    // From here on lines go straight to the transport. Lines written while the sender was stopping are picked up
+    // below, unless the transport was too slow for the flush, in which case the deadline has passed already.
+    stopped.store(true);
+    StopSending();
+    if (flushed)
+    {
+        DrainPending();
+    }
+    return flushed;
+}
+
+void Writer::DrainPending()
+{
+    if (writeImpl == &Writer::BufferedWrite)
+    {
+        DrainRing(1);
+        return;
+    }
+
+    if (fullBuffers.empty() == false)
+    {
+        packer.Clear();
+        for (const auto& batch : fullBuffers)
+        {
+            PackLines(batch);
         }
-        instance.cv_receiver.notify_one();
-        instance.TryToSend(message);
+        fullBuffers.clear();
+        SendPacked();
+    }
+    SweepLocalBuffers();
+}
+
+std::chrono::steady_clock::time_point Writer::Now() const
+{
+    return clock ? clock() : std::chrono::steady_clock::now();
+}
+
+void Writer::NotifySender()
+{
+    // Taking the lock orders this notification after the sender either checked its condition or started waiting
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+    }
+    cv_sender.notify_one();
+}
+
+void Writer::RequestSend()
+{
+    if (sendRequested.load(std::memory_order_relaxed) == false && sendRequested.exchange(true) == false)
+    {
+        NotifySender();
     }
 }
 
 void Writer::BufferedWrite(const std::string& message)
 {
-    auto& instance = GetInstance();
+    if (RingBuffer::RecordSize(message.size()) > ring->Capacity())
+    {
+        // Can never fit in the ring, so it goes out on its own
+        TryToSend(message + NEW_LINE);
+        return;
+    }
+
+    if (deferFormatting)
+    {
+        // Lines that were formatted by the caller share the ring with deferred records, so they are tagged too
+        constexpr uint32_t tag = static_cast<uint32_t>(ValueKind::Line) << KIND_SHIFT;
+        std::string record(RECORD_ID_SIZE, '\0');
+        std::memcpy(record.data(), &tag, RECORD_ID_SIZE);
+        record.append(message);
+        PushToRing(record);
+        return;
+    }
+    PushToRing(message);
+}
+
+void Writer::PushToRing(std::string_view record)
+{
+    while (ring->TryPush(record) == false)
     {
-        std::unique_lock<std::mutex> lock(instance.writeMutex);
-        // TODO: Optimize memory alloc to not exceed allocated size
-        instance.cv_receiver.wait(
-            lock, [&instance] { return instance.buffer.size() < instance.bufferSize || instance.shutdown.load(); });
-        if (instance.shutdown.load())
+        if (shutdown.load())
         {
             Logger::info("Write operation aborted due to shutdown signal");
             return;
         }
-        instance.buffer.append(message);
-        instance.buffer.push_back(NEW_LINE);
+        // The ring is full: make sure the sender is draining it, then wait for space or drop a line
+        RequestSend();
+        if (overflowPolicy == OverflowPolicy::Block)
+        {
+            WaitForSpace(RingBuffer::RecordSize(record.size()));
+        }
+        else if (overflowPolicy == OverflowPolicy::DropNewest ||
+                 DropOldestLines(RingBuffer::RecordSize(record.size())) == false)
+        {
+            RecordDrop(1, record.size() + 1);
+            return;
+        }
+    }
+
+    if (ring->Size() >= bufferSize)
+    {
+        RequestSend();
+    }
+    else if (maxLinger.count() > 0 && lingerArmed.load(std::memory_order_relaxed) == false &&
+             lingerArmed.exchange(true) == false)
+    {
+        // The first line since the last flush starts the linger deadline
+        NotifySender();
+    }
+}
+
+void Writer::WaitForSpace(size_t recordSize)
+{
+    const auto hasSpace = [this, recordSize] { return ring->Size() + recordSize <= ring->Capacity(); };
+
+    // The sender is usually midway through a batch, so a short spin saves most producers a trip through the mutex
+    for (int i = 0; i < SPINS_BEFORE_WAIT; i++)
+    {
+        if (hasSpace())
+        {
+            return;
+        }
+        std::this_thread::yield();
+    }
+
+    std::unique_lock<std::mutex> lock(writeMutex);
+    blockedProducers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    cv_producers.wait(lock, [this, &hasSpace] { return hasSpace() || shutdown.load(); });
+    blockedProducers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void Writer::AppendRecordValue(std::string& out, ValueKind kind, uint64_t bits)
+{
+    switch (kind)
+    {
+        case ValueKind::Double:
+            AppendValue(out, std::bit_cast<double>(bits));
+            break;
+        case ValueKind::Int:
+            AppendValue(out, std::bit_cast<int64_t>(bits));
+            break;
+        case ValueKind::Uint:
+            AppendValue(out, bits);
+            break;
+        case ValueKind::Line:
+            break;
+    }
+}
+
+void Writer::WriteRecord(std::atomic<uint64_t>& prefixHandle, const std::string& prefix, ValueKind kind,
+                         uint64_t bits)
+{
+    if (!m_impl)
+    {
+        Logger::error("Attempted to write with uninitialized writer implementation");
+        return;
+    }
+
+    const auto id = stopped.load(std::memory_order_relaxed) ? std::nullopt : PrefixId(prefixHandle, prefix);
+    if (id.has_value() == false)
+    {
+        // Shut down, or the prefix table is full, so the line is formatted here after all
+        std::string line;
+        line.reserve(prefix.size() + 32);
+        line.append(prefix);
+        AppendRecordValue(line, kind, bits);
+        Write(line);
+        return;
+    }
+
+    char record[RECORD_SIZE];
+    const uint32_t tag = *id | (static_cast<uint32_t>(kind) << KIND_SHIFT);
+    std::memcpy(record, &tag, RECORD_ID_SIZE);
+    std::memcpy(record + RECORD_ID_SIZE, &bits, sizeof(bits));
+    PushToRing(std::string_view(record, RECORD_SIZE));
+}
+
+std::optional<uint32_t> Writer::PrefixId(std::atomic<uint64_t>& prefixHandle, const std::string& prefix)
+{
+    // The handle holds the writer generation in its upper half and the id in its lower half, so an id cached for
+    // another writer, or before this one was initialized again, is never used
+    const uint64_t current = generation << 32;
+    const uint64_t cached = prefixHandle.load(std::memory_order_acquire);
+    if ((cached & ~uint64_t{0xFFFFFFFF}) == current)
+    {
+        const auto id = static_cast<uint32_t>(cached);
+        return id == NO_PREFIX_ID ? std::nullopt : std::optional<uint32_t>(id);
+    }
+
+    std::lock_guard<std::mutex> lock(prefixesMutex);
+    auto it = prefixIds.find(prefix);
+    if (it == prefixIds.end())
+    {
+        if (prefixes.size() >= maxPrefixes)
+        {
+            prefixHandle.store(current | NO_PREFIX_ID, std::memory_order_release);
+            return std::nullopt;
+        }
+        it = prefixIds.emplace(prefix, static_cast<uint32_t>(prefixes.size())).first;
+        prefixes.push_back(&it->first);
+    }
+    prefixHandle.store(current | it->second, std::memory_order_release);
+    return it->second;
+}
+
+void Writer::PackRecord(std::string_view record)
+{
+    uint32_t tag = 0;
+    std::memcpy(&tag, record.data(), RECORD_ID_SIZE);
+    const auto kind = static_cast<ValueKind>(tag >> KIND_SHIFT);
+    if (kind == ValueKind::Line)
+    {
+        Pack(record.substr(RECORD_ID_SIZE));
+        return;
+    }
+
+    uint64_t bits = 0;
+    std::memcpy(&bits, record.data() + RECORD_ID_SIZE, sizeof(bits));
+    const auto& prefix = *prefixes[tag & (MAX_PREFIXES - 1)];
+
+    // Coalesced values never need to be formatted on their own
+    if (coalesce && kind == ValueKind::Double && aggregator.Add(prefix, std::bit_cast<double>(bits)))
+    {
+        return;
+    }
+
+    formatted.assign(prefix);
+    AppendRecordValue(formatted, kind, bits);
+    packer.Add(formatted);
+}
+
+void Writer::Pack(std::string_view line)
+{
+    if (coalesce == false || aggregator.Add(line) == false)
+    {
+        packer.Add(line);
+    }
+}
+
+void Writer::PackLines(std::string_view lines)
+{
+    if (coalesce == false)
+    {
+        packer.AddLines(lines);
+        return;
+    }
+
+    while (lines.empty() == false)
+    {
+        auto end = lines.find(NEW_LINE);
+        end = end == std::string_view::npos ? lines.size() : end;
+        Pack(lines.substr(0, end));
+        lines.remove_prefix(std::min(end + 1, lines.size()));
+    }
+}
+
+void Writer::SendPacked()
+{
+    if (coalesce)
+    {
+        aggregator.Flush(packer);
+    }
+    if (packer.IsEmpty() == false)
+    {
+        m_impl->WriteBatch(packer.Datagrams());
     }
-    instance.buffer.size() >= instance.bufferSize ? instance.cv_sender.notify_one() : instance.cv_receiver.notify_one();
+}
+
+bool Writer::DropOldestLines(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(consumeMutex);
+    const auto consumed = ring->Consume([this](std::string_view line) { RecordDrop(1, line.size() + 1); }, bytes);
+    return consumed > 0;
+}
+
+void Writer::RecordDrop(size_t lines, size_t bytes) noexcept
+{
+    droppedLines.fetch_add(lines, std::memory_order_relaxed);
+    droppedBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+WriterStats Writer::GetStats() const
+{
+    WriterStats stats{};
+    stats.droppedLines = droppedLines.load(std::memory_order_relaxed);
+    stats.droppedBytes = droppedBytes.load(std::memory_order_relaxed);
+    if (m_impl)
+    {
+        stats.sentDatagrams = m_impl->GetSentDatagrams();
+        stats.sentBytes = m_impl->GetSentBytes();
+        stats.droppedLines += m_impl->GetDroppedLines();
+        stats.droppedBytes += m_impl->GetDroppedBytes();
+    }
+    return stats;
+}
+
+void Writer::ThreadSweep()
+{
+    std::vector<std::string> batches;
+    auto nextSweep = std::chrono::steady_clock::now() + flushInterval;
+    while (true)
+    {
+        uint64_t flushTarget = 0;
+        {
+            std::unique_lock<std::mutex> lock(writeMutex);
+            cv_sender.wait_until(lock, nextSweep,
+                                 [this]
+                                 {
+                                     return fullBuffers.empty() == false || flushesDone != flushRequests ||
+                                            shutdown.load();
+                                 });
+            if (shutdown.load() == true)
+            {
+                return;
+            }
+            batches.swap(fullBuffers);
+            flushTarget = flushRequests;
+        }
+        cv_producers.notify_all();
+
+        if (batches.empty() == false)
+        {
+            packer.Clear();
+            for (const auto& batch : batches)
+            {
+                PackLines(batch);
+            }
+            SendPacked();
+            batches.clear();
+        }
+
+        const bool flushing = flushTarget != flushesDone;
+        if (flushing || std::chrono::steady_clock::now() >= nextSweep)
+        {
+            SweepLocalBuffers();
+            nextSweep = std::chrono::steady_clock::now() + flushInterval;
+        }
+
+        if (flushing)
+        {
+            CompleteFlush(flushTarget);
+        }
+    }
+}
+
+void Writer::SweepLocalBuffers()
+{
+    std::vector<std::shared_ptr<LocalBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(localBuffersMutex);
+        buffers = localBuffers;
+    }
+
+    // Partially filled buffers are packed together, so idle threads do not each cost a separate datagram
+    std::vector<LocalBuffer*> orphans;
+    packer.Clear();
+    for (const auto& buffer : buffers)
+    {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        PackLines(buffer->lines);
+        buffer->lines.clear();
+        if (buffer->orphaned)
+        {
+            orphans.push_back(buffer.get());
+        }
+    }
+    SendPacked();
+
+    if (orphans.empty() == false)
+    {
+        std::lock_guard<std::mutex> lock(localBuffersMutex);
+        std::erase_if(localBuffers, [&orphans](const auto& buffer)
+                      { return std::find(orphans.begin(), orphans.end(), buffer.get()) != orphans.end(); });
+    }
+}
+
+Writer::LocalBuffer& Writer::AddLocalBuffer()
+{
+    // Buffers that only this thread still holds belong to writers that were initialized again or destroyed
+    auto& handles = t_localBuffers.handles;
+    std::erase_if(handles, [](const auto& handle) { return handle.buffer.use_count() == 1; });
+
+    auto buffer = std::make_shared<LocalBuffer>();
+    buffer->lines.reserve(bufferSize);
+    handles.push_back({generation, buffer});
+    std::lock_guard<std::mutex> lock(localBuffersMutex);
+    localBuffers.push_back(buffer);
+    return *buffer;
+}
+
+void Writer::ThreadLocalWrite(const std::string& message)
+{
+    LocalBuffer* buffer = nullptr;
+    for (const auto& handle : t_localBuffers.handles)
+    {
+        if (handle.generation == generation)
+        {
+            buffer = handle.buffer.get();
+            break;
+        }
+    }
+    if (buffer == nullptr)
+    {
+        // First write from this thread since the writer was initialized
+        buffer = &AddLocalBuffer();
+    }
+
+    std::string full{};
+    {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        auto& lines = buffer->lines;
+        lines.append(message);
+        lines.push_back(NEW_LINE);
+        if (lines.size() < bufferSize)
+        {
+            return;
+        }
+        full.swap(lines);
+        lines.reserve(bufferSize);
+    }
+
+    // Hand the full buffer to the sending thread
+    {
+        std::unique_lock<std::mutex> lock(writeMutex);
+        if (fullBuffers.size() >= MAX_FULL_BUFFERS)
+        {
+            // The sending thread is falling behind
+            switch (overflowPolicy)
+            {
+                case OverflowPolicy::Block:
+                    cv_producers.wait(lock, [this]
+                                      { return fullBuffers.size() < MAX_FULL_BUFFERS || shutdown.load(); });
+                    break;
+                case OverflowPolicy::DropNewest:
+                    RecordDrop(std::count(full.begin(), full.end(), NEW_LINE), full.size());
+                    return;
+                case OverflowPolicy::DropOldest:
+                    RecordDrop(std::count(fullBuffers.front().begin(), fullBuffers.front().end(), NEW_LINE),
+                               fullBuffers.front().size());
+                    fullBuffers.erase(fullBuffers.begin());
+                    break;
+            }
+        }
+        fullBuffers.push_back(std::move(full));
+    }
+    cv_sender.notify_one();
 }
 
 void Writer::NonBufferedWrite(const std::string& message)
@@ -131,23 +941,57 @@ void Writer::NonBufferedWrite(const std::string& message)
 
 void Writer::Write(const std::string& message)
 {
-    auto& instance = GetInstance();
-
-    if (!instance.m_impl)
+    if (!m_impl)
     {
         Logger::error("Attempted to write with uninitialized writer implementation");
         return;
     }
 
+    if (stopped.load(std::memory_order_relaxed))
+    {
+        // The sending thread has been shut down
+        NonBufferedWrite(message);
+        return;
+    }
+
     // Call the member function using the pointer-to-member syntax
-    (instance.*instance.writeImpl)(message);
+    (this->*writeImpl)(message);
 }
 
-void Writer::Close()
+void Writer::WriteLines(std::span<const std::string> lines)
 {
-    const auto& instance = GetInstance();
+    if (!m_impl)
+    {
+        Logger::error("Attempted to write with uninitialized writer implementation");
+        return;
+    }
 
-    if (!instance.m_impl)
+    if (writeImpl != &Writer::NonBufferedWrite && stopped.load(std::memory_order_relaxed) == false)
+    {
+        // The sending thread batches them anyway
+        for (const auto& line : lines)
+        {
+            (this->*writeImpl)(line);
+        }
+        return;
+    }
+
+    // Not the sending thread's packer, which may be in use
+    std::lock_guard<std::mutex> lock(linesMutex);
+    linesPacker.Clear();
+    for (const auto& line : lines)
+    {
+        linesPacker.Add(line);
+    }
+    if (linesPacker.IsEmpty() == false)
+    {
+        m_impl->WriteBatch(linesPacker.Datagrams());
+    }
+}
+
+void Writer::Close()
+{
+    if (!m_impl)
     {
         Logger::error("Close called on uninitialized writer");
         return;
@@ -155,7 +999,7 @@ void Writer::Close()
 
     try
     {
-        instance.m_impl->Close();
+        m_impl->Close();
     }
     catch (const std::exception& e)
     {
@@ -1,22 +1,52 @@
 #pragma once
 
-#include <singleton.h>
+#include <line_aggregator.h>
+#include <ring_buffer.h>
 #include <writer_types.h>
 
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace spectator {
 
-class Writer final : public Singleton<Writer>
+/**
+ * Writer - Buffers and sends protocol lines through one transport, formatting them on the sending thread when
+ * deferred formatting is enabled
+ *
+ * Every Registry owns a Writer, and the meters it creates keep a reference to it, so registries with different
+ * transports or buffering can live side by side. Meters constructed directly from a MeterId rather than through a
+ * Registry send through the default writer. A Registry adopts the default writer as its own unless another live
+ * Registry already has, so those meters send where the Registry's meters do.
+ */
+class Writer final
 {
    public:
-    ~Writer() override;
+    Writer();
+    ~Writer();
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    // The writer of meters constructed without a Registry. It drops their lines until a Registry initializes it.
+    static Writer& Default() { return *DefaultPtr(); }
 
    private:
-    friend class Singleton<Writer>;
     friend class Registry;
     friend class WriterTestHelper;
+    friend class Meter;
+    friend class MeterPublisher;
     friend class AgeGauge;
     friend class Counter;
     friend class DistributionSummary;
@@ -28,44 +58,252 @@ class Writer final : public Singleton<Writer>
     friend class PercentileTimer;
     friend class Timer;
 
-    // Private constructor - enforces singleton pattern
-    Writer() = default;
+    static const std::shared_ptr<Writer>& DefaultPtr();
+
+    // For a Registry to initialize and use: the default writer, unless another Registry has it already, in which case
+    // a new one. A Registry gives it back with Release when it is destroyed.
+    static std::shared_ptr<Writer> Acquire();
+    static void Release(const std::shared_ptr<Writer>& writer);
+
+    void Initialize(WriterType type, const std::string& param = "", int port = 0, unsigned int bufferSize = 0);
+
+    void Initialize(WriterType type, const std::string& param, int port, const WriterOptions& options);
+
+    void Write(const std::string& message);
+
+    // Writes lines that belong together, e.g. the samples of a polling pass. Without a buffer, they are packed into
+    // as few datagrams as possible instead of being sent one by one.
+    void WriteLines(std::span<const std::string> lines);
+
+    // Deferred formatting: meters hand over their value instead of a line when this is set
+    bool DefersFormatting() const noexcept { return deferFormatting; }
+
+    // Enqueues a value for the meter with this line prefix, to be formatted by the sending thread. The meter keeps
+    // prefixHandle, where the writer caches the id it gave the prefix.
+    void WriteValue(std::atomic<uint64_t>& prefixHandle, const std::string& prefix, double value)
+    {
+        WriteRecord(prefixHandle, prefix, ValueKind::Double, std::bit_cast<uint64_t>(value));
+    }
+
+    void WriteValue(std::atomic<uint64_t>& prefixHandle, const std::string& prefix, int64_t value)
+    {
+        WriteRecord(prefixHandle, prefix, ValueKind::Int, std::bit_cast<uint64_t>(value));
+    }
+
+    void WriteValue(std::atomic<uint64_t>& prefixHandle, const std::string& prefix, uint64_t value)
+    {
+        WriteRecord(prefixHandle, prefix, ValueKind::Uint, value);
+    }
+
+    enum class ValueKind : uint32_t
+    {
+        Double,
+        Int,
+        Uint,
+        Line  // A line that was formatted already, following the tag in place of a value
+    };
+
+    void WriteRecord(std::atomic<uint64_t>& prefixHandle, const std::string& prefix, ValueKind kind, uint64_t bits);
+
+    // Returns the id of the prefix, registering it on first use. Empty once the writer runs out of ids.
+    std::optional<uint32_t> PrefixId(std::atomic<uint64_t>& prefixHandle, const std::string& prefix);
 
-    static void Initialize(WriterType type, const std::string& param = "", int port = 0, unsigned int bufferSize = 0);
+    static void AppendRecordValue(std::string& out, ValueKind kind, uint64_t bits);
 
-    static void Write(const std::string& message);
+    // Formats a record taken from the ring into a protocol line, or coalesces it. Only call it with prefixesMutex
+    // held.
+    void PackRecord(std::string_view record);
+
+    // Sending thread: add lines to the next batch, coalescing them if enabled
+    void Pack(std::string_view line);
+    void PackLines(std::string_view lines);
+
+    // Sending thread: adds the coalesced lines and hands the batch to the transport
+    void SendPacked();
 
     void BufferedWrite(const std::string& message);
 
     void NonBufferedWrite(const std::string& message);
 
+    // Pushes a line, or a deferred record, into the ring, applying the overflow policy when the ring is full
+    void PushToRing(std::string_view record);
+
+    // Block policy: waits until the ring has room for a record of this size, or the writer shuts down
+    void WaitForSpace(size_t recordSize);
+
+    void ThreadLocalWrite(const std::string& message);
+
     void ThreadSend();
 
+    // Sending thread for thread-local buffering: sends buffers handed off by producers as they fill up, and
+    // collects partially filled buffers every flush interval
+    void ThreadSweep();
+
+    void SweepLocalBuffers();
+
+    // Sends buffered lines from the ring until less than threshold bytes are left
+    void DrainRing(size_t threshold);
+
+    // Sends whatever is still buffered, from the calling thread. Only call it once the sending thread has stopped.
+    void DrainPending();
+
+    // Called by the sending thread once it has sent everything that was buffered when flushTarget was requested
+    void CompleteFlush(uint64_t flushTarget);
+
+    // Has the sending thread send every line buffered so far, and waits up to timeout for it. Returns whether the
+    // lines were handed to the transport in time; without buffering they always are.
+    bool Flush(std::chrono::milliseconds timeout);
+
+    // Flushes within the timeout, then stops the sending thread. Lines written afterwards are sent right away.
+    bool Shutdown(std::chrono::milliseconds timeout);
+
+    // pthread_atfork handlers, for every live writer. The child gets a new transport and sending thread, and starts
+    // with empty buffers.
+    static void PrepareFork();
+    static void ResumeAfterFork();
+    static void RestartAfterFork();
+
+    void Restart();
+
+    // Stops the sending thread, if there is one, so that the writer can be initialized again
+    void StopSending();
+
+    // Wakes the sending thread, if it has not already been asked to send
+    void RequestSend();
+
+    void NotifySender();
+
+    std::chrono::steady_clock::time_point Now() const;
+
     void TryToSend(const std::string& message);
 
+    // Buffered mode, DropOldest: discards the oldest committed lines until at least bytes of line data are gone.
+    // Returns false if there was nothing to discard.
+    bool DropOldestLines(size_t bytes);
+
+    // Counts lines dropped by the writer itself, before they reach the transport
+    void RecordDrop(size_t lines, size_t bytes) noexcept;
+
     void Close();
 
+    // Datagrams sent by the transport, and lines dropped by the writer and by its transport, since it was initialized
+    WriterStats GetStats() const;
+
     // Get the Writer's implementation for testing purposes
-    static BaseWriter* GetImpl() { return Writer::GetInstance().m_impl.get(); }
-    static WriterType GetWriterType() { return GetInstance().m_currentType; }
+    BaseWriter* GetImpl() const { return m_impl.get(); }
+    WriterType GetWriterType() const { return m_currentType; }
 
     std::unique_ptr<BaseWriter> m_impl;
     WriterType m_currentType = WriterType::Memory;  // Default type
+
+    // How the writer was last initialized, so that a forked child can do the same
+    std::string m_location;
+    int m_port = 0;
+    WriterOptions m_options;
+
     bool bufferingEnabled = false;
     unsigned int bufferSize = 0;
-    std::string buffer{};
-    
+    OverflowPolicy overflowPolicy = OverflowPolicy::Block;
+
+    // Buffered mode: producers push lines into the ring without locking, and the sending thread drains it
+    std::unique_ptr<RingBuffer> ring;
+
+    // Buffered lines are flushed once the oldest has waited this long, even if the buffer is not full. The first
+    // line written after a flush arms the deadline; 0 disables it.
+    std::chrono::milliseconds maxLinger{0};
+    WriterClock clock;
+
+    // Deferred formatting: the ring holds a prefix id and a value per line, and the sending thread looks the prefix up
+    // here. Ids are handed out once per prefix and writer generation, and producers cache them in the meter state.
+    // Once maxPrefixes ids are handed out, further meters cache NO_PREFIX_ID and format their lines themselves.
+    bool deferFormatting = false;
+    size_t maxPrefixes = 0;
+    std::mutex prefixesMutex;
+    std::unordered_map<std::string, uint32_t> prefixIds;
+    std::vector<const std::string*> prefixes;  // Indexed by id, pointing at the keys of prefixIds
+    std::string formatted;  // The sending thread's scratch line
+
+    // A producer thread's own buffer in thread-local mode. Only the owning thread appends to it, and the sending
+    // thread takes it over once per sweep, so its lock is practically never contended and stays in the owner's cache.
+    struct LocalBuffer
+    {
+        std::mutex mutex;
+        std::string lines;
+        bool orphaned = false;  // The owning thread has exited, and the next sweep flushes and drops the buffer
+    };
+
+    // Owned by a thread_local, so that the buffers are marked orphaned when their thread exits. A thread has a buffer
+    // for every writer it writes to, found by the generation of the writer.
+    struct LocalBufferHandles
+    {
+        ~LocalBufferHandles();
+
+        struct Handle
+        {
+            uint64_t generation = 0;
+            std::shared_ptr<LocalBuffer> buffer;
+        };
+        std::vector<Handle> handles;
+    };
+
+    static thread_local LocalBufferHandles t_localBuffers;
+
+    // Registers a buffer for the calling thread with this writer
+    LocalBuffer& AddLocalBuffer();
+
+    // Thread-local mode: every buffer registered by a producer thread, and full buffers waiting to be sent
+    std::chrono::milliseconds flushInterval = WriterOptions::DefaultFlushInterval;
+    // Unique across all writers, and renewed on every Initialize, so threads register a new buffer with a new writer
+    uint64_t generation = 0;
+    std::mutex localBuffersMutex;
+    std::vector<std::shared_ptr<LocalBuffer>> localBuffers;
+    std::vector<std::string> fullBuffers;  // Guarded by writeMutex
+    // Signalled when the sending thread takes the full buffers, or frees space in the ring while producers wait
+    std::condition_variable cv_producers;
+
+    // Flush requests and the last one the sending thread completed, guarded by writeMutex
+    uint64_t flushRequests = 0;
+    uint64_t flushesDone = 0;
+    std::condition_variable cv_flushed;
+    std::chrono::milliseconds shutdownTimeout = WriterOptions::DefaultShutdownTimeout;
+    std::atomic<bool> stopped{false};  // Shut down; lines bypass the buffers
+
+    // Serializes draining the ring, which the sending thread does and producers do to drop the oldest lines
+    std::mutex consumeMutex;
+
+    // Used by the sending thread to split buffered lines into datagrams that the transport accepts
+    DatagramPacker packer;
+
+    // Used by WriteLines without a buffer, so that its datagrams are allocated once rather than on every call. The
+    // lock is held until the datagrams have been sent.
+    std::mutex linesMutex;
+    DatagramPacker linesPacker;
+
+    // Used by the sending thread to send one line per counter, gauge and max gauge in every batch
+    bool coalesce = false;
+    LineAggregator aggregator;
+
     // Function pointer for write strategy - member function pointer
     using WriteFunction = void (Writer::*)(const std::string&);
     WriteFunction writeImpl = &Writer::NonBufferedWrite;  // Default to non-buffered
 
 
-    // multithreading writes
+    // The mutex and condition variable are only used to park the sending thread. Producers touch them once per
+    // send request, when sendRequested goes from false to true, never once per line.
     std::mutex writeMutex;
     std::thread sendingThread;
-    std::condition_variable cv_receiver;
     std::condition_variable cv_sender;
     std::atomic<bool> shutdown{false};
+    alignas(RingBuffer::CACHE_LINE_SIZE) std::atomic<bool> sendRequested{false};
+    // Only written once per flush, so producers checking it read a shared cache line
+    std::atomic<bool> lingerArmed{false};
+
+    // Producers parked on cv_producers until the ring has room. The sending thread only notifies when it is non-zero.
+    alignas(RingBuffer::CACHE_LINE_SIZE) std::atomic<int> blockedProducers{0};
+
+    // Only written when lines are dropped, and kept away from the lines that producers write on every line
+    alignas(RingBuffer::CACHE_LINE_SIZE) std::atomic<uint64_t> droppedLines{0};
+    std::atomic<uint64_t> droppedBytes{0};
 };
 
 }  // namespace spectator
\ No newline at end of file
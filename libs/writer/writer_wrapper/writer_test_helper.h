@@ -2,13 +2,17 @@
 
 #include <writer.h>
 
+#include <memory>
+#include <span>
+#include <string>
+
 namespace spectator {
 
 /**
  * WriterTestHelper - A utility class to help with testing Writer functionality
  *
  * This class is a friend of Writer and can provide access to Writer's private
- * methods for testing purposes.
+ * methods for testing purposes. Unless a Registry is passed, it works on the default writer.
  */
 class WriterTestHelper
 {
@@ -16,11 +20,52 @@ class WriterTestHelper
     // Initialize the Writer for testing purposes
     static void InitializeWriter(WriterType type, const std::string& param = "", int port = 0, unsigned int bufferSize = 0)
     {
-        Writer::Initialize(type, param, port, bufferSize);
+        Writer::Default().Initialize(type, param, port, bufferSize);
     }
 
+    static void InitializeWriter(WriterType type, const std::string& param, int port, const WriterOptions& options)
+    {
+        Writer::Default().Initialize(type, param, port, options);
+    }
+
+    // Stop the sending thread, so the implementation can be inspected without racing it
+    static void StopSending() { Writer::Default().StopSending(); }
+
+    // Make the sending thread look at its buffers and deadlines again, e.g. after a test clock moved
+    static void WakeSender() { Writer::Default().RequestSend(); }
+
     // Get the Writer's implementation for testing purposes
-    static BaseWriter* GetImpl() { return Writer::GetInstance().m_impl.get(); }
+    static BaseWriter* GetImpl() { return Writer::Default().m_impl.get(); }
+
+    // Get the implementation of the writer that a Registry owns
+    template <typename R>
+    static BaseWriter* GetImpl(const R& registry)
+    {
+        return registry.m_writer->m_impl.get();
+    }
+
+    // Sample the polled meters of a Registry from the calling thread
+    template <typename R>
+    static void PollNow(const R& registry)
+    {
+        registry.m_publisher->PollNow();
+    }
+
+    // Replace the Writer's implementation, e.g. with one that stalls. Only call it before anything is written.
+    static void SetImpl(std::unique_ptr<BaseWriter> impl) { Writer::Default().m_impl = std::move(impl); }
+
+    static void Write(const std::string& message) { Writer::Default().Write(message); }
+
+    static void WriteLines(std::span<const std::string> lines) { Writer::Default().WriteLines(lines); }
+
+    static WriterStats GetStats() { return Writer::Default().GetStats(); }
+
+    // Producers waiting for the sending thread to free space in the ring
+    static int GetBlockedProducers() { return Writer::Default().blockedProducers.load(); }
+
+    static bool Flush(std::chrono::milliseconds timeout) { return Writer::Default().Flush(timeout); }
+
+    static bool Shutdown(std::chrono::milliseconds timeout) { return Writer::Default().Shutdown(timeout); }
 };
 
 }  // namespace spectator
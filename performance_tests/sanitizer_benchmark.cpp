@@ -0,0 +1,85 @@
+#include <meter_id.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace spectator;
+
+// Microbenchmark comparing the lookup table sanitizer used by MeterId against the std::regex_replace implementation
+// it replaced. Run with an optional iteration count: sanitizer_benchmark [iterations]
+
+static const std::regex INVALID_CHARS("[^-._A-Za-z0-9~^]");
+
+struct Input
+{
+    std::string description;
+    std::string value;
+};
+
+template <typename F>
+double NanosPerOp(const std::vector<Input>& inputs, long iterations, F&& f)
+{
+    size_t checksum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++)
+    {
+        for (const auto& input : inputs)
+        {
+            checksum += f(input.value);
+        }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    if (checksum == 0)
+    {
+        std::cerr << "unexpected checksum" << std::endl;
+    }
+    return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(iterations * inputs.size());
+}
+
+int main(int argc, char* argv[])
+{
+    const long iterations = argc > 1 ? std::stol(argv[1]) : 200000;
+
+    const std::vector<Input> inputs = {
+        {"short clean", "location"},
+        {"long clean", "correct-horse-battery-staple.with_a_long.suffix-1234567890"},
+        {"short dirty", "http status"},
+        {"long dirty", "GET /api/v1/users/{id}/profile?fields=name,email HTTP/1.1"},
+    };
+
+    std::cout << std::left << std::setw(14) << "input" << std::right << std::setw(14) << "regex ns/op"
+              << std::setw(14) << "table ns/op" << std::setw(16) << "in-place ns/op" << std::setw(10) << "speedup"
+              << std::endl;
+
+    for (const auto& input : inputs)
+    {
+        const std::vector<Input> single = {input};
+        const auto regexNanos = NanosPerOp(single, iterations, [](const std::string& s)
+                                           { return std::regex_replace(s, INVALID_CHARS, "_").size(); });
+        const auto tableNanos = NanosPerOp(single, iterations,
+                                           [](const std::string& s)
+                                           {
+                                               std::string out;
+                                               AppendSanitized(out, s);
+                                               return out.size();
+                                           });
+        std::string scratch;
+        scratch.reserve(input.value.size());
+        const auto inPlaceNanos = NanosPerOp(single, iterations,
+                                             [&scratch](const std::string& s)
+                                             {
+                                                 scratch.assign(s);
+                                                 ReplaceInvalidCharsInPlace(scratch);
+                                                 return scratch.size();
+                                             });
+
+        std::cout << std::left << std::setw(14) << input.description << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(14) << regexNanos << std::setw(14) << tableNanos
+                  << std::setw(16) << inPlaceNanos << std::setw(9) << regexNanos / tableNanos << "x" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace spectator {
+
+/**
+ * MeterCache - A bounded, thread-safe cache of values keyed by (meter type, name, tags)
+ *
+ * The Registry uses this cache so that repeated Create* calls for the same meter turn into a hash lookup instead of
+ * rebuilding and re-validating the MeterId. The cache is split into shards, each protected by its own mutex, so
+ * that concurrent callers creating different meters rarely contend. Each shard evicts its least recently used entry
+ * once it holds more than its share of the configured maximum size. A maximum size of zero disables caching.
+ */
+template <typename V>
+class MeterCache
+{
+   public:
+    using Tags = std::unordered_map<std::string, std::string>;
+
+    static constexpr size_t NumShards = 16;
+
+    explicit MeterCache(size_t maxSize) : m_maxEntriesPerShard((maxSize + NumShards - 1) / NumShards) {}
+
+    MeterCache(const MeterCache&) = delete;
+    MeterCache& operator=(const MeterCache&) = delete;
+
+    // Returns the cached value for the key, or stores and returns the result of factory() if there is none. The
+    // factory runs outside the shard lock, so two threads racing on the same new key may both call it; the first
+    // one to insert wins and both callers get the same value.
+    template <typename Factory>
+    V GetOrCreate(std::string_view type, std::string_view name, const Tags& tags, Factory&& factory)
+    {
+        if (m_maxEntriesPerShard == 0)
+        {
+            return factory();
+        }
+
+        const KeyView view{type, name, &tags, HashKey(type, name, tags)};
+        auto& shard = m_shards[view.hash % NumShards];
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (auto it = shard.entries.find(view); it != shard.entries.end())
+            {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lruPos);
+                return it->second.value;
+            }
+        }
+
+        V value = factory();
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto [it, inserted] = shard.entries.try_emplace(Key{std::string(type), std::string(name), tags, view.hash},
+                                                        Entry{value, {}});
+        if (inserted == false)
+        {
+            return it->second.value;
+        }
+        shard.lru.push_front(&it->first);
+        it->second.lruPos = shard.lru.begin();
+        if (shard.entries.size() > m_maxEntriesPerShard)
+        {
+            shard.entries.erase(*shard.lru.back());
+            shard.lru.pop_back();
+        }
+        return value;
+    }
+
+    size_t Size() const
+    {
+        size_t size = 0;
+        for (const auto& shard : m_shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            size += shard.entries.size();
+        }
+        return size;
+    }
+
+    void Clear()
+    {
+        for (auto& shard : m_shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.entries.clear();
+            shard.lru.clear();
+        }
+    }
+
+   private:
+    struct Key
+    {
+        std::string type;
+        std::string name;
+        Tags tags;
+        size_t hash;
+    };
+
+    struct KeyView
+    {
+        std::string_view type;
+        std::string_view name;
+        const Tags* tags;
+        size_t hash;
+    };
+
+    struct KeyHash
+    {
+        using is_transparent = void;
+        size_t operator()(const Key& key) const noexcept { return key.hash; }
+        size_t operator()(const KeyView& key) const noexcept { return key.hash; }
+    };
+
+    struct KeyEqual
+    {
+        using is_transparent = void;
+        static bool Equal(std::string_view t1, std::string_view n1, const Tags& g1, std::string_view t2,
+                          std::string_view n2, const Tags& g2)
+        {
+            return t1 == t2 && n1 == n2 && g1 == g2;
+        }
+        bool operator()(const Key& a, const Key& b) const
+        {
+            return a.hash == b.hash && Equal(a.type, a.name, a.tags, b.type, b.name, b.tags);
+        }
+        bool operator()(const KeyView& a, const Key& b) const
+        {
+            return a.hash == b.hash && Equal(a.type, a.name, *a.tags, b.type, b.name, b.tags);
+        }
+        bool operator()(const Key& a, const KeyView& b) const { return (*this)(b, a); }
+    };
+
+    struct Entry
+    {
+        V value;
+        typename std::list<const Key*>::iterator lruPos;
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<Key, Entry, KeyHash, KeyEqual> entries;
+        std::list<const Key*> lru;
+    };
+
+    // Tags are combined with a commutative sum so the hash does not depend on the map's iteration order
+    static size_t HashKey(std::string_view type, std::string_view name, const Tags& tags) noexcept
+    {
+        const std::hash<std::string_view> hasher{};
+        size_t tagsHash = 0;
+        for (const auto& [key, value] : tags)
+        {
+            const size_t keyHash = hasher(key);
+            tagsHash += keyHash ^ (hasher(value) + 0x9e3779b9 + (keyHash << 6) + (keyHash >> 2));
+        }
+        return hasher(type) ^ (hasher(name) << 1) ^ (tagsHash << 2);
+    }
+
+    const size_t m_maxEntriesPerShard;
+    std::array<Shard, NumShards> m_shards;
+};
+
+}  // namespace spectator
@@ -0,0 +1,265 @@
+#include <meter_publisher.h>
+
+#include <logger.h>
+#include <util.h>
+
+#include <algorithm>
+#include <exception>
+#include <new>
+#include <random>
+
+#include <pthread.h>
+
+namespace spectator {
+
+// Every live publisher, so that the fork handlers can reach them
+static std::mutex s_publishersMutex;
+static std::vector<MeterPublisher*> s_publishers;
+
+MeterPublisher::MeterPublisher(std::shared_ptr<Writer> writer, std::chrono::milliseconds interval)
+    : m_writer(std::move(writer)), m_interval(interval)
+{
+    // Registered after the writers' handlers, so the thread is parked before the writers lock their buffers, and
+    // started again once the child's writers have been restarted
+    static std::once_flag forkHandlers;
+    std::call_once(forkHandlers,
+                   []
+                   {
+                       pthread_atfork(&MeterPublisher::PrepareFork, &MeterPublisher::ResumeAfterFork,
+                                      &MeterPublisher::RestartAfterFork);
+                   });
+
+    std::lock_guard<std::mutex> lock(s_publishersMutex);
+    s_publishers.push_back(this);
+}
+
+MeterPublisher::~MeterPublisher()
+{
+    {
+        std::lock_guard<std::mutex> lock(s_publishersMutex);
+        std::erase(s_publishers, this);
+    }
+    Stop();
+}
+
+ShardedCounter MeterPublisher::GetOrAddShardedCounter(const MeterStatePtr& state)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (auto it = m_shardedCounters.find(state.get()); it != m_shardedCounters.end())
+    {
+        return it->second;
+    }
+
+    Start();
+    return m_shardedCounters.emplace(state.get(), ShardedCounter(state)).first->second;
+}
+
+PolledMeterHandle MeterPublisher::AddPolledMeter(MeterStatePtr state, PolledMeter::Sampler sample)
+{
+    auto meter = std::make_shared<PolledMeter>(std::move(state), std::move(sample));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Start();
+    m_polledMeters.push_back(meter);
+    return PolledMeterHandle(meter);
+}
+
+void MeterPublisher::Start()
+{
+    std::lock_guard<std::mutex> threadLock(m_threadMutex);
+    if (m_thread.joinable() == false && m_stopping == false && m_parking == false)
+    {
+        m_thread = std::thread(&MeterPublisher::Run, this);
+    }
+}
+
+void MeterPublisher::PublishNow()
+{
+    // Counters are published outside the lock, so a slow writer does not hold up threads creating counters
+    std::vector<ShardedCounter> counters;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        counters.reserve(m_shardedCounters.size());
+        for (auto it = m_shardedCounters.begin(); it != m_shardedCounters.end();)
+        {
+            // Once only the publisher refers to a counter, this is its last publication
+            const bool shared = it->second.IsShared();
+            counters.push_back(it->second);
+            it = shared ? std::next(it) : m_shardedCounters.erase(it);
+        }
+    }
+
+    for (const auto& counter : counters)
+    {
+        counter.Publish();
+    }
+}
+
+void MeterPublisher::PollNow()
+{
+    std::vector<std::shared_ptr<PolledMeter>> meters;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        meters = m_polledMeters;
+    }
+
+    m_polledLines.clear();
+    bool anyRemoved = false;
+    for (const auto& meter : meters)
+    {
+        std::lock_guard<std::recursive_mutex> lock(meter->mutex);
+        if (meter->removed)
+        {
+            anyRemoved = true;
+            continue;
+        }
+
+        std::optional<double> value;
+        try
+        {
+            value = meter->sample();
+        }
+        catch (const std::exception& e)
+        {
+            Logger::warn("Failed to sample polled meter {}: {}", meter->state->GetId().GetName(), e.what());
+            continue;
+        }
+
+        if (value.has_value() == false || meter->removed)
+        {
+            // The source is gone, or the sample function removed the meter
+            meter->removed = true;
+            anyRemoved = true;
+            continue;
+        }
+        auto& line = m_polledLines.emplace_back(meter->state->GetLinePrefix());
+        AppendValue(line, *value);
+    }
+
+    if (m_polledLines.empty() == false)
+    {
+        m_writer->WriteLines(m_polledLines);
+    }
+
+    if (anyRemoved)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::erase_if(m_polledMeters,
+                      [](const auto& meter)
+                      {
+                          std::lock_guard<std::recursive_mutex> meterLock(meter->mutex);
+                          return meter->removed;
+                      });
+    }
+}
+
+void MeterPublisher::Stop()
+{
+    {
+        // A fork parking the thread meanwhile would join it too
+        std::lock_guard<std::mutex> publishersLock(s_publishersMutex);
+        {
+            std::lock_guard<std::mutex> lock(m_threadMutex);
+            m_stopping = true;
+        }
+        m_cv.notify_all();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+    PublishNow();
+}
+
+bool MeterPublisher::Park()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_threadMutex);
+        // A sampler forking on the publishing thread cannot join it
+        if (m_thread.get_id() == std::this_thread::get_id())
+        {
+            return false;
+        }
+        m_parking = true;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable() == false)
+    {
+        return false;
+    }
+    m_thread.join();
+    return true;
+}
+
+void MeterPublisher::Unpark()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_threadMutex);
+        m_parking = false;
+    }
+    if (m_parked)
+    {
+        Start();
+    }
+}
+
+void MeterPublisher::PrepareFork()
+{
+    // The publishing threads are joined, so that none is halfway through writing or sampling in the child, and the
+    // counter map is locked so that it is consistent there
+    s_publishersMutex.lock();
+    for (auto* publisher : s_publishers)
+    {
+        publisher->m_parked = publisher->Park();
+        publisher->m_mutex.lock();
+    }
+}
+
+void MeterPublisher::ResumeAfterFork()
+{
+    for (auto* publisher : s_publishers)
+    {
+        publisher->m_mutex.unlock();
+        publisher->Unpark();
+    }
+    s_publishersMutex.unlock();
+}
+
+void MeterPublisher::RestartAfterFork()
+{
+    // Only the forking thread exists in the child. It held these locks across fork(), and the condition variable may
+    // still count the parent's waiters, so they are all replaced rather than unlocked.
+    Logger::Muted muted;
+    new (&s_publishersMutex) std::mutex();
+    for (auto* publisher : s_publishers)
+    {
+        new (&publisher->m_mutex) std::mutex();
+        new (&publisher->m_threadMutex) std::mutex();
+        new (&publisher->m_cv) std::condition_variable();
+        new (&publisher->m_thread) std::thread();
+        publisher->Unpark();
+    }
+}
+
+void MeterPublisher::Run()
+{
+    Logger::debug("MeterPublisher started, publishing every {}ms", m_interval.count());
+    std::mt19937_64 random(std::random_device{}());
+    std::uniform_int_distribution<int64_t> jitter(0, std::max<int64_t>(m_interval.count() - 1, 0));
+    auto next = std::chrono::steady_clock::now() + std::chrono::milliseconds(jitter(random));
+    std::unique_lock<std::mutex> lock(m_threadMutex);
+    while (m_stopping == false && m_parking == false)
+    {
+        if (m_cv.wait_until(lock, next, [this] { return m_stopping || m_parking; }))
+        {
+            return;
+        }
+        lock.unlock();
+        PublishNow();
+        PollNow();
+        // A pass that overran the interval is not made up for with a burst of passes
+        next = std::max(next + m_interval, std::chrono::steady_clock::now());
+        lock.lock();
+    }
+}
+
+}  // namespace spectator
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <meter.h>
+#include <polled_meter.h>
+#include <sharded_counter.h>
+#include <writer.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace spectator {
+
+/**
+ * MeterPublisher - Periodically sends the meters of a Registry that are not sent as they are recorded
+ *
+ * Holds every sharded counter the Registry handed out and publishes their totals on a background thread, which is
+ * started with the first meter. A counter that neither handles nor the meter cache refer to any more is published one
+ * last time and dropped. When the publisher stops, e.g. because its Registry is destroyed, it publishes the counters
+ * once more.
+ *
+ * On the same thread it samples the polled meters and writes their lines as one batch. The first pass is delayed by
+ * a random part of the interval, so that processes started together do not all send at the same moment.
+ *
+ * The thread is stopped for the duration of a fork(), and started again in both processes if it was running. A child
+ * publishes the counters it inherited, so a pre-forking server keeps sending from every worker.
+ */
+class MeterPublisher
+{
+   public:
+    MeterPublisher(std::shared_ptr<Writer> writer, std::chrono::milliseconds interval);
+    ~MeterPublisher();
+
+    MeterPublisher(const MeterPublisher&) = delete;
+    MeterPublisher& operator=(const MeterPublisher&) = delete;
+
+    // Returns the sharded counter for the meter state, registering a new one on first use
+    ShardedCounter GetOrAddShardedCounter(const MeterStatePtr& state);
+
+    PolledMeterHandle AddPolledMeter(MeterStatePtr state, PolledMeter::Sampler sample);
+
+    // Sends the totals accumulated so far from the calling thread
+    void PublishNow();
+
+    // Samples the polled meters from the calling thread, and sends their values in one batch
+    void PollNow();
+
+    // Stops the publishing thread, after publishing once more
+    void Stop();
+
+   private:
+    void Run();
+
+    // Starts the publishing thread, unless it is running, parked or has been stopped
+    void Start();
+
+    // pthread_atfork handlers, for every live publisher. The thread is joined before the fork, so that neither process
+    // inherits it halfway through publishing, and started again afterwards.
+    static void PrepareFork();
+    static void ResumeAfterFork();
+    static void RestartAfterFork();
+
+    // Joins the publishing thread, and keeps it from being started until Unpark. Returns whether it was running.
+    bool Park();
+
+    // Allows the thread to be started again, and starts it if Park found it running
+    void Unpark();
+
+    const std::shared_ptr<Writer> m_writer;
+    const std::chrono::milliseconds m_interval;
+
+    // Keyed by the meter state, which the counter keeps alive, so that counters with the same id share their slots
+    std::mutex m_mutex;
+    std::unordered_map<const MeterState*, ShardedCounter> m_shardedCounters;
+    std::vector<std::shared_ptr<PolledMeter>> m_polledMeters;
+    std::vector<std::string> m_polledLines;  // Only used by the thread polling
+
+    std::mutex m_threadMutex;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+    bool m_stopping = false;
+    bool m_parking = false;
+    bool m_parked = false;  // Whether the thread was running when it was parked for a fork
+};
+
+}  // namespace spectator
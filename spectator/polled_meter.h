@@ -0,0 +1,91 @@
+#pragma once
+
+#include <meter.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace spectator {
+
+/**
+ * PolledMeter - A gauge or monotonic counter whose value is sampled by the Registry instead of set by the application
+ *
+ * The sample function runs on the publishing thread every publish interval. It returns nothing once its source is
+ * gone, e.g. because the object it watched through a weak pointer was destroyed, and the meter is then dropped.
+ */
+struct PolledMeter
+{
+    using Sampler = std::function<std::optional<double>()>;
+
+    PolledMeter(MeterStatePtr meterState, Sampler sampler) : state(std::move(meterState)), sample(std::move(sampler))
+    {
+    }
+
+    const MeterStatePtr state;
+    const Sampler sample;
+
+    // Held while sampling, so that once Remove returns the sample function is not running and never runs again.
+    // Recursive, so that a sample function may remove its own meter, or another one, on the publishing thread.
+    std::recursive_mutex mutex;
+    bool removed = false;
+};
+
+// Samples a value from an object the application owns, for as long as the object is alive
+template <typename T, typename F>
+PolledMeter::Sampler SampleWeakly(std::weak_ptr<T> object, F sample)
+{
+    return [object = std::move(object), sample = std::move(sample)]() -> std::optional<double>
+    {
+        if (auto locked = object.lock())
+        {
+            return static_cast<double>(sample(*locked));
+        }
+        return std::nullopt;
+    };
+}
+
+/**
+ * PolledMeterHandle - Returned when a polled meter is registered, to remove it again
+ *
+ * Dropping the handle leaves the meter registered. The handle may outlive the Registry.
+ */
+class PolledMeterHandle
+{
+   public:
+    PolledMeterHandle() = default;
+
+    // Stops sampling, waiting for a sample that is running on another thread to finish. Called from within a sample
+    // function, the value being sampled is not sent.
+    void Remove()
+    {
+        if (auto meter = m_meter.lock())
+        {
+            std::lock_guard<std::recursive_mutex> lock(meter->mutex);
+            meter->removed = true;
+        }
+    }
+
+    bool IsRegistered() const
+    {
+        auto meter = m_meter.lock();
+        if (meter == nullptr)
+        {
+            return false;
+        }
+        std::lock_guard<std::recursive_mutex> lock(meter->mutex);
+        return meter->removed == false;
+    }
+
+   private:
+    friend class MeterPublisher;
+
+    explicit PolledMeterHandle(std::weak_ptr<PolledMeter> meter) : m_meter(std::move(meter)) {}
+
+    std::weak_ptr<PolledMeter> m_meter;
+};
+
+}  // namespace spectator
@@ -1,7 +1,12 @@
 #include <registry.h>
 
+#include <bit>
+#include <regex>
+
 namespace spectator {
 
+// The meter cache key of sharded counters, which share the counter type symbol but not its state
+static constexpr auto SHARDED_COUNTER_CACHE_KEY = "c~sharded";
 
 std::pair<std::string, int> ParseUdpAddress(const std::string& address) 
 {
@@ -36,27 +41,49 @@ std::string ParseUnixAddress(const std::string& address)
     return matches[1].str();
 }
 
-Registry::Registry(const Config& config) : m_config(config) 
+Registry::Registry(const Config& config)
+    : m_config(config),
+      m_writer(Writer::Acquire()),
+      m_meterCache(std::make_unique<MeterCache<MeterStatePtr>>(config.GetMeterCacheSize())),
+      m_publisher(std::make_unique<MeterPublisher>(m_writer, config.GetPublishInterval()))
 {
     if (config.GetWriterType() == WriterType::Memory)
     {
         Logger::info("Registry initializing Memory Writer");
-        Writer::Initialize(config.GetWriterType(), "", 0, this->m_config.GetWriterBufferSize()); 
+        m_writer->Initialize(config.GetWriterType(), "", 0, this->m_config.GetWriterOptions());
     }
     else if (config.GetWriterType() == WriterType::UDP)
     {
         auto [ip, port] = ParseUdpAddress(this->m_config.GetWriterLocation());
         Logger::info("Registry initializing UDP Writer at {}:{}", ip, port);
-        Writer::Initialize(config.GetWriterType(), ip, port, this->m_config.GetWriterBufferSize()); 
+        m_writer->Initialize(config.GetWriterType(), ip, port, this->m_config.GetWriterOptions());
     }
     else if (config.GetWriterType() == WriterType::Unix)
     {
         auto socketPath = ParseUnixAddress(this->m_config.GetWriterLocation());
         Logger::info("Registry initializing UDS Writer at {}", socketPath);
-        Writer::Initialize(config.GetWriterType(), socketPath, 0, this->m_config.GetWriterBufferSize()); 
+        m_writer->Initialize(config.GetWriterType(), socketPath, 0, this->m_config.GetWriterOptions());
     }    
 }
 
+Registry::~Registry()
+{
+    // The last counter totals go out before the writer can be handed to the next registry
+    if (m_publisher != nullptr)
+    {
+        m_publisher->Stop();
+    }
+    Writer::Release(m_writer);
+}
+
+Registry::Registry(Registry&& other)
+    : m_config(other.m_config),
+      m_writer(std::move(other.m_writer)),
+      m_meterCache(std::move(other.m_meterCache)),
+      m_publisher(std::move(other.m_publisher))
+{
+}
+
 MeterId Registry::CreateNewId(const std::string& name, const std::unordered_map<std::string, std::string>& tags) const
 {
     MeterId new_meter_id(name, tags);
@@ -68,91 +95,206 @@ MeterId Registry::CreateNewId(const std::string& name, const std::unordered_map<
     return new_meter_id.WithTags(this->m_config.GetExtraTags());
 }
 
+MeterStatePtr Registry::GetOrCreateState(std::string_view type, const std::string& name,
+                                         const std::unordered_map<std::string, std::string>& tags,
+                                         const std::optional<ChangeSuppression>& suppression) const
+{
+    const auto factory = [&] { return NewState(type, CreateNewId(name, tags), suppression); };
+    if (suppression.has_value())
+    {
+        // Calls asking for other settings get a meter of their own, rather than whichever was created first
+        const auto key = std::string(type) + "~" + std::to_string(std::bit_cast<uint64_t>(suppression->epsilon)) + "~" +
+                         std::to_string(suppression->keepalive.count());
+        return this->m_meterCache->GetOrCreate(key, name, tags, factory);
+    }
+    return this->m_meterCache->GetOrCreate(type, name, tags, factory);
+}
+
+MeterStatePtr Registry::NewState(std::string_view type, const MeterId& meter_id,
+                                 const std::optional<ChangeSuppression>& suppression) const
+{
+    return MeterStatePtr(new MeterState(meter_id, std::string(type), m_writer, suppression));
+}
+
 AgeGauge Registry::CreateAgeGauge(const std::string& name, const std::unordered_map<std::string, std::string>& tags) const
 {
-    return AgeGauge(CreateNewId(name, tags));
+    return AgeGauge(GetOrCreateState(AGE_GAUGE_TYPE_SYMBOL, name, tags));
 }
 
-AgeGauge Registry::CreateAgeGauge(const MeterId& meter_id) const { return AgeGauge(meter_id); }
+AgeGauge Registry::CreateAgeGauge(const MeterId& meter_id) const
+{
+    return AgeGauge(NewState(AGE_GAUGE_TYPE_SYMBOL, meter_id));
+}
 
 Counter Registry::CreateCounter(const std::string& name, const std::unordered_map<std::string, std::string>& tags) const
 {
-    return Counter(CreateNewId(name, tags));
+    return Counter(GetOrCreateState(COUNTER_TYPE_SYMBOL, name, tags));
 }
 
-Counter Registry::CreateCounter(const MeterId& meter_id) const { return Counter(meter_id); }
+Counter Registry::CreateCounter(const MeterId& meter_id) const
+{
+    return Counter(NewState(COUNTER_TYPE_SYMBOL, meter_id));
+}
 
 DistributionSummary Registry::CreateDistributionSummary(const std::string& name,
                                                    const std::unordered_map<std::string, std::string>& tags) const
 {
-    return DistributionSummary(CreateNewId(name, tags));
+    return DistributionSummary(GetOrCreateState(DisTRIBUTION_SUMMARY_TYPE_SYMBOL, name, tags));
 }
 
 DistributionSummary Registry::CreateDistributionSummary(const MeterId& meter_id) const
 {
-    return DistributionSummary(meter_id);
+    return DistributionSummary(NewState(DisTRIBUTION_SUMMARY_TYPE_SYMBOL, meter_id));
 }
 
 Gauge Registry::CreateGauge(const std::string& name, const std::unordered_map<std::string, std::string>& tags,
                       const std::optional<int>& ttl_seconds) const
 {
-    return Gauge(CreateNewId(name, tags), ttl_seconds);
+    return Gauge(GetOrCreateState(Gauge::TypeSymbol(ttl_seconds), name, tags));
 }
 
 Gauge Registry::CreateGauge(const MeterId& meter_id, const std::optional<int>& ttl_seconds) const
 {
-    return Gauge(meter_id, ttl_seconds);
+    return Gauge(NewState(Gauge::TypeSymbol(ttl_seconds), meter_id));
+}
+
+Gauge Registry::CreateGauge(const std::string& name, const std::unordered_map<std::string, std::string>& tags,
+                            const std::optional<int>& ttl_seconds, const ChangeSuppression& suppression) const
+{
+    return Gauge(GetOrCreateState(Gauge::TypeSymbol(ttl_seconds), name, tags,
+                                  Gauge::WithinTtl(suppression, ttl_seconds)));
+}
+
+Gauge Registry::CreateGauge(const MeterId& meter_id, const std::optional<int>& ttl_seconds,
+                            const ChangeSuppression& suppression) const
+{
+    return Gauge(NewState(Gauge::TypeSymbol(ttl_seconds), meter_id, Gauge::WithinTtl(suppression, ttl_seconds)));
 }
 
 MaxGauge Registry::CreateMaxGauge(const std::string& name, const std::unordered_map<std::string, std::string>& tags) const
 {
-    return MaxGauge(CreateNewId(name, tags));
+    return MaxGauge(GetOrCreateState(MAX_GAUGE_TYPE_SYMBOL, name, tags));
 }
 
-MaxGauge Registry::CreateMaxGauge(const MeterId& meter_id) const { return MaxGauge(meter_id); }
+MaxGauge Registry::CreateMaxGauge(const MeterId& meter_id) const
+{
+    return MaxGauge(NewState(MAX_GAUGE_TYPE_SYMBOL, meter_id));
+}
 
 MonotonicCounter Registry::CreateMonotonicCounter(const std::string& name,
                                              const std::unordered_map<std::string, std::string>& tags) const
 {
-    return MonotonicCounter(CreateNewId(name, tags));
+    return MonotonicCounter(GetOrCreateState(MONOTONIC_COUNTER_TYPE_SYMBOL, name, tags));
 }
 
-MonotonicCounter Registry::CreateMonotonicCounter(const MeterId& meter_id) const { return MonotonicCounter(meter_id); }
+MonotonicCounter Registry::CreateMonotonicCounter(const MeterId& meter_id) const
+{
+    return MonotonicCounter(NewState(MONOTONIC_COUNTER_TYPE_SYMBOL, meter_id));
+}
+
+MonotonicCounter Registry::CreateMonotonicCounter(const std::string& name,
+                                                  const std::unordered_map<std::string, std::string>& tags,
+                                                  const ChangeSuppression& suppression) const
+{
+    return MonotonicCounter(GetOrCreateState(MONOTONIC_COUNTER_TYPE_SYMBOL, name, tags, suppression));
+}
+
+MonotonicCounter Registry::CreateMonotonicCounter(const MeterId& meter_id, const ChangeSuppression& suppression) const
+{
+    return MonotonicCounter(NewState(MONOTONIC_COUNTER_TYPE_SYMBOL, meter_id, suppression));
+}
 
 MonotonicCounterUint Registry::CreateMonotonicCounterUint(const std::string& name,
                                                       const std::unordered_map<std::string, std::string>& tags) const
 {
-    return MonotonicCounterUint(CreateNewId(name, tags));
+    return MonotonicCounterUint(GetOrCreateState(MONOTONIC_COUNTER_UINT_TYPE_SYMBOL, name, tags));
 }
 
 MonotonicCounterUint Registry::CreateMonotonicCounterUint(const MeterId& meter_id) const
 {
-    return MonotonicCounterUint(meter_id);
+    return MonotonicCounterUint(NewState(MONOTONIC_COUNTER_UINT_TYPE_SYMBOL, meter_id));
 }
 
 PercentileDistributionSummary Registry::CreatePercentDistributionSummary(
     const std::string& name, const std::unordered_map<std::string, std::string>& tags) const
 {
-    return PercentileDistributionSummary(CreateNewId(name, tags));
+    return PercentileDistributionSummary(
+        GetOrCreateState(PERCENTILE_DISTRIBUTION_SUMMARY_TYPE_SYMBOL, name, tags));
 }
 
 PercentileDistributionSummary Registry::CreatePercentDistributionSummary(const MeterId& meter_id) const
 {
-    return PercentileDistributionSummary(meter_id);
+    return PercentileDistributionSummary(NewState(PERCENTILE_DISTRIBUTION_SUMMARY_TYPE_SYMBOL, meter_id));
 }
 
 PercentileTimer Registry::CreatePercentTimer(const std::string& name, const std::unordered_map<std::string, std::string>& tags) const
 {
-    return PercentileTimer(CreateNewId(name, tags));
+    return PercentileTimer(GetOrCreateState(PERCENTILE_TIMER_TYPE_SYMBOL, name, tags));
 }
 
-PercentileTimer Registry::CreatePercentTimer(const MeterId& meter_id) const { return PercentileTimer(meter_id); }
+PercentileTimer Registry::CreatePercentTimer(const MeterId& meter_id) const
+{
+    return PercentileTimer(NewState(PERCENTILE_TIMER_TYPE_SYMBOL, meter_id));
+}
 
 Timer Registry::CreateTimer(const std::string& name, const std::unordered_map<std::string, std::string>& tags) const
 {
-    return Timer(CreateNewId(name, tags));
+    return Timer(GetOrCreateState(TIMER_TYPE_SYMBOL, name, tags));
+}
+
+Timer Registry::CreateTimer(const MeterId& meter_id) const
+{
+    return Timer(NewState(TIMER_TYPE_SYMBOL, meter_id));
+}
+
+ShardedCounter Registry::CreateShardedCounter(const std::string& name,
+                                              const std::unordered_map<std::string, std::string>& tags) const
+{
+    const auto factory = [&] { return MeterStatePtr(new ShardedCounterState(CreateNewId(name, tags), m_writer)); };
+    return m_publisher->GetOrAddShardedCounter(
+        m_meterCache->GetOrCreate(SHARDED_COUNTER_CACHE_KEY, name, tags, factory));
+}
+
+ShardedCounter Registry::CreateShardedCounter(const MeterId& meter_id) const
+{
+    return m_publisher->GetOrAddShardedCounter(MeterStatePtr(new ShardedCounterState(meter_id, m_writer)));
 }
 
-Timer Registry::CreateTimer(const MeterId& meter_id) const { return Timer(meter_id); }
+PolledMeterHandle Registry::PollGauge(const std::string& name,
+                                     const std::unordered_map<std::string, std::string>& tags,
+                                     std::function<double()> sample) const
+{
+    return AddPolledMeter(GAUGE_TYPE_SYMBOL, name, tags,
+                          [sample = std::move(sample)]() -> std::optional<double> { return sample(); });
+}
+
+PolledMeterHandle Registry::PollMonotonicCounter(const std::string& name,
+                                                const std::unordered_map<std::string, std::string>& tags,
+                                                std::function<double()> sample) const
+{
+    return AddPolledMeter(MONOTONIC_COUNTER_TYPE_SYMBOL, name, tags,
+                          [sample = std::move(sample)]() -> std::optional<double> { return sample(); });
+}
+
+PolledMeterHandle Registry::AddPolledMeter(std::string_view type, const std::string& name,
+                                           const std::unordered_map<std::string, std::string>& tags,
+                                           PolledMeter::Sampler sample) const
+{
+    return m_publisher->AddPolledMeter(GetOrCreateState(type, name, tags), std::move(sample));
+}
+
+FlushResult Registry::Flush(std::chrono::milliseconds timeout) const
+{
+    const auto before = m_writer->GetStats();
+    m_publisher->PublishNow();
+    FlushResult result{};
+    result.completed = m_writer->Flush(timeout);
+    const auto after = m_writer->GetStats();
+    result.stats.sentDatagrams = after.sentDatagrams - before.sentDatagrams;
+    result.stats.sentBytes = after.sentBytes - before.sentBytes;
+    result.stats.droppedLines = after.droppedLines - before.droppedLines;
+    result.stats.droppedBytes = after.droppedBytes - before.droppedBytes;
+    return result;
+}
 
 }  // namespace spectator
\ No newline at end of file
@@ -2,10 +2,16 @@
 
 #include <config.h>
 #include <logger.h>
+#include <meter_cache.h>
 #include <meter_id.h>
+#include <meter_publisher.h>
 #include <meter_types.h>
+#include <polled_meter.h>
 #include <writer.h>
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <string>
 #include <map>
@@ -19,7 +25,15 @@ class Registry
 {
    public:
     explicit Registry(const Config& config);
-    ~Registry() = default;
+    ~Registry();
+
+    // A registry can be moved, which keeps its meters sending through its writer, but not copied, since it owns the
+    // meter cache and the publishing thread. Like its Config, it cannot be assigned to. A moved-from registry can
+    // only be destroyed.
+    Registry(Registry&& other);
+    Registry& operator=(Registry&& other) = delete;
+    Registry(const Registry&) = delete;
+    Registry& operator=(const Registry&) = delete;
 
     MeterId CreateNewId(const std::string& name, const std::unordered_map<std::string, std::string>& tags = {}) const;
 
@@ -46,6 +60,14 @@ class Registry
 
     Gauge CreateGauge(const MeterId& meter_id, const std::optional<int>& ttl_seconds = std::nullopt) const;
 
+    // A gauge that only sends values which changed, beyond the epsilon, plus a keepalive before its TTL would
+    // expire. Calls with the same name, tags and suppression share what was sent last.
+    Gauge CreateGauge(const std::string& name, const std::unordered_map<std::string, std::string>& tags,
+                      const std::optional<int>& ttl_seconds, const ChangeSuppression& suppression) const;
+
+    Gauge CreateGauge(const MeterId& meter_id, const std::optional<int>& ttl_seconds,
+                      const ChangeSuppression& suppression) const;
+
     MaxGauge CreateMaxGauge(const std::string& name, const std::unordered_map<std::string, std::string>& tags =
                                                     std::unordered_map<std::string, std::string>()) const;
 
@@ -57,6 +79,13 @@ class Registry
 
     MonotonicCounter CreateMonotonicCounter(const MeterId& meter_id) const;
 
+    // A monotonic counter that only sends amounts which changed, beyond the epsilon, plus a periodic keepalive
+    MonotonicCounter CreateMonotonicCounter(const std::string& name,
+                                            const std::unordered_map<std::string, std::string>& tags,
+                                            const ChangeSuppression& suppression) const;
+
+    MonotonicCounter CreateMonotonicCounter(const MeterId& meter_id, const ChangeSuppression& suppression) const;
+
     MonotonicCounterUint CreateMonotonicCounterUint(
         const std::string& name,
         const std::unordered_map<std::string, std::string>& tags = std::unordered_map<std::string, std::string>()) const;
@@ -79,8 +108,100 @@ class Registry
 
     Timer CreateTimer(const MeterId& meter_id) const;
 
+    // A counter that adds up increments in memory, and is sent as one line per publish interval. Calls with the same
+    // name and tags return handles to the same counter, as long as it is in the meter cache.
+    ShardedCounter CreateShardedCounter(
+        const std::string& name,
+        const std::unordered_map<std::string, std::string>& tags = std::unordered_map<std::string, std::string>()) const;
+
+    ShardedCounter CreateShardedCounter(const MeterId& meter_id) const;
+
+    // Polled meters are sampled on a background thread every publish interval, instead of being set on the request
+    // path, and the values of each pass are written as one batch. They stay registered until the handle removes
+    // them, or the object they watch through a weak pointer is gone.
+    PolledMeterHandle PollGauge(const std::string& name, const std::unordered_map<std::string, std::string>& tags,
+                                std::function<double()> sample) const;
+
+    // Samples the object with sample(const T&) for as long as it is alive
+    template <typename T, typename F>
+    PolledMeterHandle PollGauge(const std::string& name, const std::unordered_map<std::string, std::string>& tags,
+                                std::weak_ptr<T> object, F sample) const
+    {
+        return AddPolledMeter(GAUGE_TYPE_SYMBOL, name, tags, SampleWeakly(std::move(object), std::move(sample)));
+    }
+
+    // Samples an atomic the application owns, for as long as it is alive
+    template <typename T>
+    PolledMeterHandle PollGauge(const std::string& name, const std::unordered_map<std::string, std::string>& tags,
+                                std::weak_ptr<std::atomic<T>> value) const
+    {
+        return PollGauge(name, tags, std::move(value), [](const std::atomic<T>& v) { return v.load(); });
+    }
+
+    // A monotonically increasing total, e.g. the bytes a pool has handed out, which spectatord turns into a rate
+    PolledMeterHandle PollMonotonicCounter(const std::string& name,
+                                           const std::unordered_map<std::string, std::string>& tags,
+                                           std::function<double()> sample) const;
+
+    template <typename T, typename F>
+    PolledMeterHandle PollMonotonicCounter(const std::string& name,
+                                           const std::unordered_map<std::string, std::string>& tags,
+                                           std::weak_ptr<T> object, F sample) const
+    {
+        return AddPolledMeter(MONOTONIC_COUNTER_TYPE_SYMBOL, name, tags,
+                              SampleWeakly(std::move(object), std::move(sample)));
+    }
+
+    template <typename T>
+    PolledMeterHandle PollMonotonicCounter(const std::string& name,
+                                           const std::unordered_map<std::string, std::string>& tags,
+                                           std::weak_ptr<std::atomic<T>> value) const
+    {
+        return PollMonotonicCounter(name, tags, std::move(value), [](const std::atomic<T>& v) { return v.load(); });
+    }
+
+    // Datagrams sent, and lines dropped instead of sent because of the overflow policy or a failing socket
+    WriterStats GetWriterStats() const { return m_writer->GetStats(); }
+
+    // Publishes the sharded counters, then sends every buffered line and blocks until they have been handed to the
+    // socket, or the timeout has passed. Without a buffer, lines are sent as they are recorded, so this returns right
+    // away.
+    FlushResult Flush(std::chrono::milliseconds timeout = WriterOptions::DefaultShutdownTimeout) const;
+
+    // Sends the buffered lines, waiting up to timeout for them to leave, and stops the sending thread. Later lines
+    // are sent right away. Returns whether everything was sent in time. The writer also does this when it is
+    // destroyed at exit, with the configured shutdown timeout.
+    bool Shutdown(std::chrono::milliseconds timeout) const
+    {
+        m_publisher->PublishNow();
+        return m_writer->Shutdown(timeout);
+    }
+
    private:
+    friend class WriterTestHelper;
+
+    // Returns the shared state for a meter of the given type, creating and caching it on first use. Meters that
+    // suppress unchanged values are cached apart from those that do not, and apart from those with other settings.
+    MeterStatePtr GetOrCreateState(std::string_view type, const std::string& name,
+                                   const std::unordered_map<std::string, std::string>& tags,
+                                   const std::optional<ChangeSuppression>& suppression = std::nullopt) const;
+
+    PolledMeterHandle AddPolledMeter(std::string_view type, const std::string& name,
+                                     const std::unordered_map<std::string, std::string>& tags,
+                                     PolledMeter::Sampler sample) const;
+
+    // Returns new state for a meter with exactly this id, bound to this registry's writer
+    MeterStatePtr NewState(std::string_view type, const MeterId& meter_id,
+                           const std::optional<ChangeSuppression>& suppression = std::nullopt) const;
+
     Config m_config;
+    // Every registry sends through its own writer, which its meters share. The first one adopts the default writer.
+    std::shared_ptr<Writer> m_writer;
+    // Held by pointer, so that the registry can be moved while meters and the publishing thread refer to them
+    std::unique_ptr<MeterCache<MeterStatePtr>> m_meterCache;
+    // Publishes sharded counters and samples polled meters. Destroyed first, so it sends the last counter totals while
+    // the writer is still there.
+    std::unique_ptr<MeterPublisher> m_publisher;
 };
 
 }  // namespace spectator
\ No newline at end of file
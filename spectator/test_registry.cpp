@@ -1,5 +1,14 @@
 #include <gtest/gtest.h>
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <registry.h>
 #include <writer_test_helper.h>
@@ -15,8 +24,8 @@ TEST(RegistryTest, Close)
     auto c = r.CreateCounter("counter");
     c.Increment();
 
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
-    EXPECT_EQ("c:counter:1.000000\n", memoryWriter->LastLine());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
+    EXPECT_EQ("c:counter:1\n", memoryWriter->LastLine());
 
     memoryWriter->Close();
     EXPECT_TRUE(memoryWriter->IsEmpty());
@@ -28,28 +37,28 @@ TEST(RegistryTest, AgeGauge)
     auto r = Registry(config);
     auto g1 = r.CreateAgeGauge("age_gauge");
     auto g2 = r.CreateAgeGauge("age_gauge", {{"my-tags", "bar"}});
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     g1.Set(1);
-    EXPECT_EQ("A:age_gauge:1.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("A:age_gauge:1\n", memoryWriter->LastLine());
 
     g2.Set(2);
-    EXPECT_EQ("A:age_gauge,my-tags=bar:2.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("A:age_gauge,my-tags=bar:2\n", memoryWriter->LastLine());
 }
 
 TEST(RegistryTest, AgeGaugeWithId)
 {
     Config config(WriterConfig(WriterTypes::Memory), {{"extra-tags", "foo"}});
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto g = r.CreateAgeGauge(r.CreateNewId("age_gauge", {{"my-tags", "bar"}}));
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     g.Set(0);
-    EXPECT_EQ("A:age_gauge,extra-tags=foo,my-tags=bar:0.000000\n",
+    EXPECT_EQ("A:age_gauge,extra-tags=foo,my-tags=bar:0\n",
               ParseProtocolLine(memoryWriter->LastLine()).value().to_string());
 }
 
@@ -59,45 +68,45 @@ TEST(RegistryTest, Counter)
     auto r = Registry(config);
     auto c1 = r.CreateCounter("counter");
     auto c2 = r.CreateCounter("counter", {{"my-tags", "bar"}});
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     c1.Increment();
-    EXPECT_EQ("c:counter:1.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("c:counter:1\n", memoryWriter->LastLine());
 
     c2.Increment();
-    EXPECT_EQ("c:counter,my-tags=bar:1.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("c:counter,my-tags=bar:1\n", memoryWriter->LastLine());
 
     c1.Increment(2);
-    EXPECT_EQ("c:counter:2.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("c:counter:2\n", memoryWriter->LastLine());
 
     c2.Increment(2);
-    EXPECT_EQ("c:counter,my-tags=bar:2.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("c:counter,my-tags=bar:2\n", memoryWriter->LastLine());
 
     r.CreateCounter("counter").Increment(3);
-    EXPECT_EQ("c:counter:3.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("c:counter:3\n", memoryWriter->LastLine());
 }
 
 TEST(RegistryTest, CounterWithId)
 {
     Config config(WriterConfig(WriterTypes::Memory), {{"extra-tags", "foo"}});
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto c = r.CreateCounter(r.CreateNewId("counter", {{"my-tags", "bar"}}));
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     c.Increment();
-    EXPECT_EQ("c:counter,extra-tags=foo,my-tags=bar:1.000000\n",
+    EXPECT_EQ("c:counter,extra-tags=foo,my-tags=bar:1\n",
               ParseProtocolLine(memoryWriter->LastLine()).value().to_string());
 
     c.Increment(2);
-    EXPECT_EQ("c:counter,extra-tags=foo,my-tags=bar:2.000000\n",
+    EXPECT_EQ("c:counter,extra-tags=foo,my-tags=bar:2\n",
               ParseProtocolLine(memoryWriter->LastLine()).value().to_string());
 
     r.CreateCounter("counter", {{"my-tags", "bar"}}).Increment(3);
-    EXPECT_EQ("c:counter,extra-tags=foo,my-tags=bar:3.000000\n",
+    EXPECT_EQ("c:counter,extra-tags=foo,my-tags=bar:3\n",
               ParseProtocolLine(memoryWriter->LastLine()).value().to_string());
 }
 
@@ -105,26 +114,26 @@ TEST(RegistryTest, DistributionSummary)
 {
     auto config = Config(WriterConfig(WriterTypes::Memory));
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto d = r.CreateDistributionSummary("distribution_summary");
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     d.Record(42);
-    EXPECT_EQ("d:distribution_summary:42.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("d:distribution_summary:42\n", memoryWriter->LastLine());
 }
 
 TEST(RegistryTest, DistributionSummaryWithId)
 {
     Config config(WriterConfig(WriterTypes::Memory), {{"extra-tags", "foo"}});
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto d = r.CreateDistributionSummary(r.CreateNewId("distribution_summary", {{"my-tags", "bar"}}));
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     d.Record(42);
-    EXPECT_EQ("d:distribution_summary,extra-tags=foo,my-tags=bar:42.000000\n",
+    EXPECT_EQ("d:distribution_summary,extra-tags=foo,my-tags=bar:42\n",
               ParseProtocolLine(memoryWriter->LastLine()).value().to_string());
 }
 
@@ -132,26 +141,26 @@ TEST(RegistryTest, Gauge)
 {
     auto config = Config(WriterConfig(WriterTypes::Memory));
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto g = r.CreateGauge("gauge");
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     g.Set(42);
-    EXPECT_EQ("g:gauge:42.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("g:gauge:42\n", memoryWriter->LastLine());
 }
 
 TEST(RegistryTest, GaugeWithId)
 {
     Config config(WriterConfig(WriterTypes::Memory), {{"extra-tags", "foo"}});
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto g = r.CreateGauge(r.CreateNewId("gauge", {{"my-tags", "bar"}}));
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     g.Set(42);
-    EXPECT_EQ("g:gauge,extra-tags=foo,my-tags=bar:42.000000\n",
+    EXPECT_EQ("g:gauge,extra-tags=foo,my-tags=bar:42\n",
               ParseProtocolLine(memoryWriter->LastLine()).value().to_string());
 }
 
@@ -159,50 +168,50 @@ TEST(RegistryTest, GaugeWithIdWithTtlSeconds)
 {
     Config config(WriterConfig(WriterTypes::Memory), {{"extra-tags", "foo"}});
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
     
     auto g = r.CreateGauge(r.CreateNewId("gauge", {{"my-tags", "bar"}}), 120);
     EXPECT_TRUE(memoryWriter->IsEmpty());
     g.Set(42);
-    EXPECT_EQ("g,120:gauge,extra-tags=foo,my-tags=bar:42.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("g,120:gauge,extra-tags=foo,my-tags=bar:42\n", memoryWriter->LastLine());
 }
 
 TEST(RegistryTest, GaugeWithTtlSeconds) {
     Config config{WriterConfig(WriterTypes::Memory)};
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto g = r.CreateGauge("gauge", {}, 120);
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     g.Set(42);
-    EXPECT_EQ("g,120:gauge:42.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("g,120:gauge:42\n", memoryWriter->LastLine());
 }
 
 TEST(RegistryTest, MaxGauge)
 {
     auto config = Config(WriterConfig(WriterTypes::Memory));
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto g = r.CreateMaxGauge("max_gauge");
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     g.Set(42);
-    EXPECT_EQ("m:max_gauge:42.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("m:max_gauge:42\n", memoryWriter->LastLine());
 }
 
 TEST(RegistryTest, MaxGaugeWithId)
 {
     Config config(WriterConfig(WriterTypes::Memory), {{"extra-tags", "foo"}});
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto g = r.CreateMaxGauge(r.CreateNewId("max_gauge", {{"my-tags", "bar"}}));
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     g.Set(42);
-    EXPECT_EQ("m:max_gauge,extra-tags=foo,my-tags=bar:42.000000\n",
+    EXPECT_EQ("m:max_gauge,extra-tags=foo,my-tags=bar:42\n",
               ParseProtocolLine(memoryWriter->LastLine()).value().to_string());
 }
 
@@ -210,26 +219,26 @@ TEST(RegistryTest, MonotonicCounter)
 {
     auto config = Config(WriterConfig(WriterTypes::Memory));
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto c = r.CreateMonotonicCounter("monotonic_counter");
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     c.Set(42);
-    EXPECT_EQ("C:monotonic_counter:42.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("C:monotonic_counter:42\n", memoryWriter->LastLine());
 }
 
 TEST(RegistryTest, MonotonicCounterWithId)
 {
     Config config(WriterConfig(WriterTypes::Memory), {{"extra-tags", "foo"}});
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto c = r.CreateMonotonicCounter(r.CreateNewId("monotonic_counter", {{"my-tags", "bar"}}));
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     c.Set(42);
-    EXPECT_EQ("C:monotonic_counter,extra-tags=foo,my-tags=bar:42.000000\n",
+    EXPECT_EQ("C:monotonic_counter,extra-tags=foo,my-tags=bar:42\n",
               ParseProtocolLine(memoryWriter->LastLine()).value().to_string());
 }
 
@@ -237,7 +246,7 @@ TEST(RegistryTest, MonotonicCounterUint)
 {
     auto config = Config(WriterConfig(WriterTypes::Memory));
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto c = r.CreateMonotonicCounterUint("monotonic_counter_uint");
     EXPECT_TRUE(memoryWriter->IsEmpty());
@@ -250,7 +259,7 @@ TEST(RegistryTest, MonotonicCounterUintWithId)
 {
     Config config(WriterConfig(WriterTypes::Memory), {{"extra-tags", "foo"}});
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto c = r.CreateMonotonicCounterUint(r.CreateNewId("monotonic_counter_uint", {{"my-tags", "bar"}}));
     EXPECT_TRUE(memoryWriter->IsEmpty());
@@ -277,7 +286,7 @@ TEST(RegistryTest, PctDistributionSummary)
 {
     auto config = Config(WriterConfig(WriterTypes::Memory));
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto d = r.CreatePercentDistributionSummary("pct_distribution_summary");
     EXPECT_TRUE(memoryWriter->IsEmpty());
@@ -290,7 +299,7 @@ TEST(RegistryTest, PctDistributionSummaryWithId)
 {
     Config config(WriterConfig(WriterTypes::Memory), {{"extra-tags", "foo"}});
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto d = r.CreatePercentDistributionSummary(r.CreateNewId("pct_distribution_summary", {{"my-tags", "bar"}}));
     EXPECT_TRUE(memoryWriter->IsEmpty());
@@ -304,26 +313,26 @@ TEST(RegistryTest, PctTimer)
 {
     auto config = Config(WriterConfig(WriterTypes::Memory));
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto t = r.CreatePercentTimer("pct_timer");
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     t.Record(42);
-    EXPECT_EQ("T:pct_timer:42.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("T:pct_timer:42\n", memoryWriter->LastLine());
 }
 
 TEST(RegistryTest, PctTimerWithId)
 {
     Config config(WriterConfig(WriterTypes::Memory), {{"extra-tags", "foo"}});
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto t = r.CreatePercentTimer(r.CreateNewId("pct_timer", {{"my-tags", "bar"}}));
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     t.Record(42);
-    EXPECT_EQ("T:pct_timer,extra-tags=foo,my-tags=bar:42.000000\n",
+    EXPECT_EQ("T:pct_timer,extra-tags=foo,my-tags=bar:42\n",
               ParseProtocolLine(memoryWriter->LastLine()).value().to_string());
 }
 
@@ -331,25 +340,440 @@ TEST(RegistryTest, Timer)
 {
     auto config = Config(WriterConfig(WriterTypes::Memory));
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto t = r.CreateTimer("timer");
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     t.Record(42);
-    EXPECT_EQ("t:timer:42.000000\n", memoryWriter->LastLine());
+    EXPECT_EQ("t:timer:42\n", memoryWriter->LastLine());
 }
 
 TEST(RegistryTest, TimerWithId)
 {
     Config config(WriterConfig(WriterTypes::Memory), {{"extra-tags", "foo"}});
     auto r = Registry(config);
-    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
 
     auto t = r.CreateTimer(r.CreateNewId("timer", {{"my-tags", "bar"}}));
     EXPECT_TRUE(memoryWriter->IsEmpty());
 
     t.Record(42);
-    EXPECT_EQ("t:timer,extra-tags=foo,my-tags=bar:42.000000\n",
+    EXPECT_EQ("t:timer,extra-tags=foo,my-tags=bar:42\n",
+              ParseProtocolLine(memoryWriter->LastLine()).value().to_string());
+}
+
+TEST(RegistryTest, CachedMetersShareId)
+{
+    Config config(WriterConfig(WriterTypes::Memory), {{"extra-tags", "foo"}});
+    auto r = Registry(config);
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
+
+    auto c1 = r.CreateCounter("counter", {{"my-tags", "bar"}});
+    auto c2 = r.CreateCounter("counter", {{"my-tags", "bar"}});
+    EXPECT_EQ(c1.GetId(), c2.GetId());
+    EXPECT_EQ(c1.GetState(), c2.GetState());
+    EXPECT_EQ(&c1.GetId(), &c2.GetId());
+
+    // The same name and tags with a different meter type is a distinct cache entry
+    auto g = r.CreateGauge("counter", {{"my-tags", "bar"}});
+    g.Set(1);
+    EXPECT_EQ("g:counter,extra-tags=foo,my-tags=bar:1\n",
               ParseProtocolLine(memoryWriter->LastLine()).value().to_string());
-}
\ No newline at end of file
+}
+
+TEST(RegistryTest, CachedGaugesWithTtl)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
+
+    r.CreateGauge("gauge").Set(1);
+    EXPECT_EQ("g:gauge:1\n", memoryWriter->LastLine());
+
+    r.CreateGauge("gauge", {}, 120).Set(1);
+    EXPECT_EQ("g,120:gauge:1\n", memoryWriter->LastLine());
+
+    r.CreateGauge("gauge").Set(2);
+    EXPECT_EQ("g:gauge:2\n", memoryWriter->LastLine());
+}
+
+TEST(RegistryTest, MeterCacheIsBounded)
+{
+    MeterCache<int> cache(MeterCache<int>::NumShards);
+    int created = 0;
+    auto factory = [&created] { return ++created; };
+
+    for (int i = 0; i < 1000; i++)
+    {
+        cache.GetOrCreate("c", "counter" + std::to_string(i), {}, factory);
+    }
+    EXPECT_EQ(1000, created);
+    EXPECT_LE(cache.Size(), MeterCache<int>::NumShards);
+
+    // Recently used entries are kept, so a repeat lookup does not call the factory
+    const auto value = cache.GetOrCreate("c", "counter999", {}, factory);
+    EXPECT_EQ(1000, value);
+    EXPECT_EQ(1000, created);
+}
+
+TEST(RegistryTest, MeterCacheTagOrder)
+{
+    MeterCache<int> cache(100);
+    int created = 0;
+    auto factory = [&created] { return ++created; };
+
+    cache.GetOrCreate("c", "counter", {{"a", "1"}, {"b", "2"}, {"c", "3"}}, factory);
+    cache.GetOrCreate("c", "counter", {{"c", "3"}, {"b", "2"}, {"a", "1"}}, factory);
+    EXPECT_EQ(1, created);
+
+    cache.GetOrCreate("c", "counter", {{"a", "2"}, {"b", "1"}, {"c", "3"}}, factory);
+    cache.GetOrCreate("t", "counter", {{"a", "1"}, {"b", "2"}, {"c", "3"}}, factory);
+    EXPECT_EQ(3, created);
+}
+
+TEST(RegistryTest, MeterCacheDisabled)
+{
+    Config config(WriterConfig(WriterTypes::Memory));
+    config.SetMeterCacheSize(0);
+    auto r = Registry(config);
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
+
+    r.CreateCounter("counter").Increment();
+    r.CreateCounter("counter").Increment();
+    EXPECT_EQ(2, memoryWriter->GetMessages().size());
+    EXPECT_EQ("c:counter:1\n", memoryWriter->LastLine());
+}
+
+TEST(RegistryTest, FlushSendsBufferedLines)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory, 1000));
+    auto r = Registry(config);
+    auto c = r.CreateCounter("counter");
+    c.Increment();
+    c.Increment();
+    c.Increment();
+
+    const auto result = r.Flush(std::chrono::seconds(1));
+    EXPECT_TRUE(result.completed);
+    EXPECT_EQ(1u, result.stats.sentDatagrams);
+    EXPECT_EQ(36u, result.stats.sentBytes);
+    EXPECT_EQ(0u, result.stats.droppedLines);
+
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
+    EXPECT_EQ("c:counter:1\nc:counter:1\nc:counter:1\n", memoryWriter->LastLine());
+}
+
+TEST(RegistryTest, FlushWithoutBuffer)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    r.CreateCounter("counter").Increment();
+
+    // The line was sent when it was recorded
+    const auto result = r.Flush(std::chrono::seconds(1));
+    EXPECT_TRUE(result.completed);
+    EXPECT_EQ(0u, result.stats.sentDatagrams);
+    EXPECT_EQ(1u, r.GetWriterStats().sentDatagrams);
+}
+
+TEST(RegistryTest, RegistriesHaveTheirOwnWriters)
+{
+    auto r1 = Registry(Config(WriterConfig(WriterTypes::Memory)));
+    auto r2 = Registry(Config(WriterConfig(WriterTypes::Memory, 1000)));
+    auto writer1 = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r1));
+    auto writer2 = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r2));
+    ASSERT_NE(writer1, writer2);
+
+    r1.CreateCounter("first").Increment();
+    r2.CreateCounter("second").Increment();
+    EXPECT_EQ("c:first:1\n", writer1->LastLine());
+    EXPECT_TRUE(writer2->IsEmpty());
+
+    EXPECT_TRUE(r2.Flush(std::chrono::seconds(1)).completed);
+    EXPECT_EQ("c:second:1\n", writer2->LastLine());
+    EXPECT_EQ(1u, writer1->GetMessages().size());
+}
+
+TEST(RegistryTest, MetersWithoutARegistrySendThroughTheFirstRegistry)
+{
+    auto r1 = Registry(Config(WriterConfig(WriterTypes::Memory)));
+    auto writer1 = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r1));
+    Counter(MeterId("direct")).Increment();
+    EXPECT_EQ("c:direct:1\n", writer1->LastLine());
+
+    // A second registry gets a writer of its own, and leaves the default one alone
+    auto r2 = Registry(Config(WriterConfig(WriterTypes::Memory)));
+    auto writer2 = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r2));
+    ASSERT_NE(writer1, writer2);
+    Counter(MeterId("direct")).Increment(2);
+    EXPECT_EQ("c:direct:2\n", writer1->LastLine());
+    EXPECT_TRUE(writer2->IsEmpty());
+}
+
+TEST(RegistryTest, MovedRegistryKeepsItsMeters)
+{
+    auto r1 = Registry(Config(WriterConfig(WriterTypes::Memory)));
+    auto counter = r1.CreateShardedCounter("sharded");
+    counter.Increment();
+    r1.CreateCounter("moved");
+
+    Registry r2(std::move(r1));
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r2));
+    r2.CreateCounter("moved").Increment();
+    EXPECT_EQ("c:moved:1\n", memoryWriter->LastLine());
+
+    std::optional<Registry> r3;
+    r3.emplace(std::move(r2));
+    EXPECT_EQ(memoryWriter, WriterTestHelper::GetImpl(*r3));
+    EXPECT_TRUE(r3->Flush(std::chrono::seconds(1)).completed);
+    EXPECT_EQ("c:sharded:1\n", memoryWriter->LastLine());
+}
+
+TEST(RegistryTest, ShardedCounterIsSentWhenPublished)
+{
+    auto r = Registry(Config(WriterConfig(WriterTypes::Memory)));
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
+
+    auto c = r.CreateShardedCounter("sharded", {{"my-tags", "bar"}});
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back(
+            [&r]
+            {
+                // Handles created by name share the counter
+                auto counter = r.CreateShardedCounter("sharded", {{"my-tags", "bar"}});
+                for (int i = 0; i < 1000; i++)
+                {
+                    counter.Increment();
+                }
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    c.Increment(0.5);
+    c.Increment(-1);
+    EXPECT_TRUE(memoryWriter->IsEmpty());
+
+    r.Flush(std::chrono::seconds(1));
+    ASSERT_EQ(1u, memoryWriter->GetMessages().size());
+    EXPECT_EQ("c:sharded,my-tags=bar:4000.5\n", memoryWriter->LastLine());
+
+    // Nothing was added since
+    r.Flush(std::chrono::seconds(1));
+    EXPECT_EQ(1u, memoryWriter->GetMessages().size());
+}
+
+TEST(RegistryTest, ShardedCountersAreCachedApartFromCounters)
+{
+    auto r = Registry(Config(WriterConfig(WriterTypes::Memory)));
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
+
+    auto counter = r.CreateCounter("requests");
+    auto sharded = r.CreateShardedCounter("requests");
+    EXPECT_NE(counter.GetState(), sharded.GetState());
+    EXPECT_EQ(sharded.GetState(), r.CreateShardedCounter("requests").GetState());
+
+    counter.Increment();
+    sharded.Increment(2);
+    r.Flush(std::chrono::seconds(1));
+    ASSERT_EQ(2u, memoryWriter->GetMessages().size());
+    EXPECT_EQ("c:requests:2\n", memoryWriter->LastLine());
+}
+
+TEST(RegistryTest, ShardedCounterIsPublishedPeriodically)
+{
+    Config config(WriterConfig(WriterTypes::Memory));
+    config.SetPublishInterval(std::chrono::milliseconds(10));
+    auto r = Registry(config);
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
+
+    r.CreateShardedCounter(r.CreateNewId("sharded")).Increment(3);
+    for (int i = 0; i < 500 && r.GetWriterStats().sentDatagrams == 0; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ("c:sharded:3\n", memoryWriter->LastLine());
+}
+
+TEST(RegistryTest, ChildPublishesAndClosesAfterFork)
+{
+    Config config(WriterConfig(WriterTypes::Memory));
+    config.SetPublishInterval(std::chrono::milliseconds(10));
+    std::optional<Registry> r;
+    r.emplace(config);
+    auto counter = r->CreateShardedCounter("sharded");
+
+    const pid_t pid = fork();
+    ASSERT_NE(pid, -1);
+    if (pid == 0)
+    {
+        // Killed, rather than hanging the test, if the child cannot destroy the registry
+        alarm(10);
+        counter.Increment(3);
+        for (int i = 0; i < 500 && r->GetWriterStats().sentDatagrams == 0; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(*r));
+        const bool published = memoryWriter->LastLine() == "c:sharded:3\n";
+        r.reset();
+        _exit(published ? 0 : 1);
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    // The parent's thread was started again too
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(*r));
+    counter.Increment(2);
+    for (int i = 0; i < 500 && r->GetWriterStats().sentDatagrams == 0; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ("c:sharded:2\n", memoryWriter->LastLine());
+}
+
+TEST(RegistryTest, ChangeSuppressedMetersShareWhatWasSent)
+{
+    auto r = Registry(Config(WriterConfig(WriterTypes::Memory)));
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
+
+    // A polling loop that creates the gauge on every pass
+    for (int i = 0; i < 10; i++)
+    {
+        r.CreateGauge("pool.size", {}, std::nullopt, ChangeSuppression{}).Set(8);
+        r.CreateMonotonicCounter("bytes", {}, ChangeSuppression{}).Set(1024);
+    }
+    EXPECT_EQ(2u, memoryWriter->GetMessages().size());
+
+    // Meters without suppression are separate
+    r.CreateGauge("pool.size").Set(8);
+    EXPECT_EQ(3u, memoryWriter->GetMessages().size());
+
+    r.CreateGauge(r.CreateNewId("pool.size"), 60, ChangeSuppression{}).Set(8);
+    EXPECT_EQ("g,60:pool.size:8\n", memoryWriter->LastLine());
+
+    // So are meters with other suppression settings, which apply their own
+    r.CreateMonotonicCounter("bytes", {}, ChangeSuppression{2.0}).Set(1024);
+    EXPECT_EQ(5u, memoryWriter->GetMessages().size());
+    r.CreateMonotonicCounter("bytes", {}, ChangeSuppression{2.0}).Set(1025);
+    r.CreateMonotonicCounter("bytes", {}, ChangeSuppression{}).Set(1025);
+    EXPECT_EQ(6u, memoryWriter->GetMessages().size());
+    EXPECT_EQ("C:bytes:1025\n", memoryWriter->LastLine());
+}
+
+TEST(RegistryTest, PolledMetersAreSentInOneBatch)
+{
+    // Long enough that the publishing thread does not poll during the test
+    Config config(WriterConfig(WriterTypes::Memory));
+    config.SetPublishInterval(std::chrono::hours(24));
+    auto r = Registry(config);
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
+
+    auto connections = std::make_shared<std::atomic<int>>(8);
+    auto pool = std::make_shared<std::vector<int>>(3, 0);
+    r.PollGauge("pool.connections", {}, std::weak_ptr<std::atomic<int>>(connections));
+    r.PollGauge("pool.size", {{"pool", "db"}}, std::weak_ptr<std::vector<int>>(pool),
+                [](const std::vector<int>& v) { return v.size(); });
+    r.PollMonotonicCounter("bytes", {}, [] { return 1024.0; });
+    r.PollGauge("broken", {}, []() -> double { throw std::runtime_error("unavailable"); });
+    EXPECT_TRUE(memoryWriter->IsEmpty());
+
+    WriterTestHelper::PollNow(r);
+    ASSERT_EQ(1u, memoryWriter->GetMessages().size());
+    EXPECT_EQ("g:pool.connections:8\ng:pool.size,pool=db:3\nC:bytes:1024\n", memoryWriter->LastLine());
+
+    connections->store(5);
+    WriterTestHelper::PollNow(r);
+    ASSERT_EQ(2u, memoryWriter->GetMessages().size());
+    EXPECT_EQ("g:pool.connections:5\ng:pool.size,pool=db:3\nC:bytes:1024\n", memoryWriter->LastLine());
+}
+
+TEST(RegistryTest, PolledMetersCanBeRemoved)
+{
+    Config config(WriterConfig(WriterTypes::Memory));
+    config.SetPublishInterval(std::chrono::hours(24));
+    auto r = Registry(config);
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
+
+    int samples = 0;
+    auto handle = r.PollGauge("removed", {}, [&samples] { return ++samples; });
+    auto value = std::make_shared<std::atomic<double>>(1.5);
+    auto expiring = r.PollMonotonicCounter("expired", {}, std::weak_ptr<std::atomic<double>>(value));
+    EXPECT_TRUE(handle.IsRegistered());
+    EXPECT_TRUE(expiring.IsRegistered());
+
+    WriterTestHelper::PollNow(r);
+    EXPECT_EQ("g:removed:1\nC:expired:1.5\n", memoryWriter->LastLine());
+
+    handle.Remove();
+    EXPECT_FALSE(handle.IsRegistered());
+    WriterTestHelper::PollNow(r);
+    EXPECT_EQ("C:expired:1.5\n", memoryWriter->LastLine());
+    EXPECT_EQ(1, samples);
+
+    // Once the value is gone, the meter is dropped
+    value.reset();
+    WriterTestHelper::PollNow(r);
+    EXPECT_FALSE(expiring.IsRegistered());
+    WriterTestHelper::PollNow(r);
+    EXPECT_EQ(2u, memoryWriter->GetMessages().size());
+
+    // Removing twice, or through a default handle, does nothing
+    handle.Remove();
+    PolledMeterHandle().Remove();
+    EXPECT_FALSE(PolledMeterHandle().IsRegistered());
+}
+
+TEST(RegistryTest, PolledMeterCanRemoveItselfWhileSampled)
+{
+    Config config(WriterConfig(WriterTypes::Memory));
+    config.SetPublishInterval(std::chrono::hours(24));
+    auto r = Registry(config);
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl(r));
+
+    // Sampled first, removing both itself and the meter sampled after it
+    auto handle = std::make_shared<PolledMeterHandle>();
+    PolledMeterHandle other;
+    *handle = r.PollGauge("once", {},
+                          [handle, &other]
+                          {
+                              other.Remove();
+                              handle->Remove();
+                              return 1.0;
+                          });
+    other = r.PollGauge("other", {}, [] { return 2.0; });
+
+    // Neither the meter that removed itself nor the one it removed is sent
+    WriterTestHelper::PollNow(r);
+    EXPECT_FALSE(handle->IsRegistered());
+    EXPECT_FALSE(other.IsRegistered());
+    EXPECT_EQ(0u, memoryWriter->GetMessages().size());
+}
+
+TEST(RegistryTest, PolledMetersAreSampledPeriodically)
+{
+    Config config(WriterConfig(WriterTypes::Memory));
+    config.SetPublishInterval(std::chrono::milliseconds(10));
+    auto r = Registry(config);
+
+    std::atomic<int> samples{0};
+    auto handle = r.PollGauge("sampled", {}, [&samples] { return ++samples; });
+    for (int i = 0; i < 500 && r.GetWriterStats().sentDatagrams < 2; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_GE(r.GetWriterStats().sentDatagrams, 2u);
+
+    // The sample function is not called after Remove returns, so it may now refer to what goes out of scope
+    handle.Remove();
+    const auto sampled = samples.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(sampled, samples.load());
+}